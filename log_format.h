@@ -0,0 +1,80 @@
+// Layout of the binary log written by "main --binary-log" and read by logdecode
+#ifndef LOG_FORMAT_H
+#define LOG_FORMAT_H
+
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <string_view>
+
+// The file starts with this magic, followed by records. Every record is a LogRecordHeader and
+// argumentCount 8-byte arguments, both in the writer's byte order.
+const char BINARY_LOG_MAGIC[8] = {'B', 'O', 'O', 'K', 'L', 'O', 'G', '1'};
+const size_t LOG_MAX_ARGUMENTS = 8;
+
+// Definition records carry (id, length) and are followed by the text, padded to 8 bytes. A
+// string is defined before the first event that refers to it, and an event's format before
+// the first event with that id; ids are never reused within a file.
+const uint16_t LOG_RECORD_STRING = 0xFFFF;
+const uint16_t LOG_RECORD_EVENT = 0xFFFE;
+
+// Kinds of event arguments, two bits each in LogRecordHeader::argumentKinds
+enum LogArgumentKind : uint16_t { LOG_INTEGER = 0, LOG_REAL = 1, LOG_STRING = 2 };
+
+struct LogRecordHeader {
+    uint64_t timestamp;  // nanoseconds since the Unix epoch
+    uint16_t event;
+    uint8_t level;
+    uint8_t argumentCount;
+    uint16_t argumentKinds;
+    uint16_t reserved;
+};
+static_assert(sizeof(LogRecordHeader) == 16, "log records must stay fixed-layout");
+
+// Names of the log levels, indexed by LogLevel
+const char* const LOG_LEVEL_NAMES[] = {"INFO", "WARNING", "ERROR", "DEBUG"};
+
+// Function to read the kind of an argument from a record header
+inline LogArgumentKind logArgumentKind(uint16_t kinds, size_t index) {
+    return static_cast<LogArgumentKind>((kinds >> (2 * index)) & 3);
+}
+
+// Function to convert a time to the local calendar on any platform
+inline void toLocalTime(std::time_t time, std::tm& localTime) {
+#ifdef _WIN32
+    localtime_s(&localTime, &time);
+#else
+    localtime_r(&time, &localTime);
+#endif
+}
+
+// Function to render a numeric argument the way the text log prints it
+inline std::string renderLogNumber(LogArgumentKind kind, uint64_t value) {
+    if (kind == LOG_REAL) {
+        double real;
+        std::memcpy(&real, &value, sizeof(real));
+        return std::to_string(real);
+    }
+    return std::to_string(static_cast<int64_t>(value));
+}
+
+// Function to substitute rendered arguments for the "{}" placeholders of an event format
+inline std::string renderLogFormat(std::string_view format, const std::string* arguments,
+                                   size_t count) {
+    std::string out;
+    size_t next = 0;
+    for (size_t i = 0; i < format.size(); i++) {
+        if (format[i] == '{' && i + 1 < format.size() && format[i + 1] == '}') {
+            if (next < count) {
+                out += arguments[next++];
+            }
+            i++;
+        } else {
+            out += format[i];
+        }
+    }
+    return out;
+}
+
+#endif
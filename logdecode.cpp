@@ -0,0 +1,153 @@
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "log_format.h"
+
+void printRecord(const LogRecordHeader& header, const std::string& message,
+                 const std::vector<std::string>& arguments, bool json);
+std::string formatTimestamp(uint64_t timestamp);
+std::string escapeJson(const std::string& text);
+bool readText(std::ifstream& in, uint64_t length, std::string& text);
+
+// Renders a binary log written by "main --binary-log" as the text log would have shown it, or as
+// one JSON object per line with the raw arguments kept alongside the message
+int main(int argc, char* argv[]) {
+    bool json = argc == 3 && std::string(argv[2]) == "--json";
+    if (argc < 2 || argc > 3 || (argc == 3 && !json)) {
+        std::cerr << "Usage: " << argv[0] << " <file> [--json]\n";
+        return 1;
+    }
+
+    std::ifstream in(argv[1], std::ios::binary);
+    char magic[sizeof(BINARY_LOG_MAGIC)];
+    if (!in.read(magic, sizeof(magic))
+        || std::string(magic, sizeof(magic))
+               != std::string(BINARY_LOG_MAGIC, sizeof(BINARY_LOG_MAGIC))) {
+        std::cerr << argv[1] << " is not a binary book log.\n";
+        return 1;
+    }
+
+    std::unordered_map<uint64_t, std::string> strings;
+    std::unordered_map<uint64_t, std::string> formats;
+    LogRecordHeader header;
+    uint64_t values[LOG_MAX_ARGUMENTS];
+    size_t records = 0;
+    while (in.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        if (header.argumentCount > LOG_MAX_ARGUMENTS
+            || !in.read(reinterpret_cast<char*>(values), header.argumentCount * sizeof(uint64_t))) {
+            std::cerr << "Truncated record after " << records << " records.\n";
+            return 1;
+        }
+
+        // Definitions only feed the tables; the events that follow refer to them by id
+        if (header.event == LOG_RECORD_STRING || header.event == LOG_RECORD_EVENT) {
+            std::string text;
+            if (header.argumentCount != 2 || !readText(in, values[1], text)) {
+                std::cerr << "Truncated definition after " << records << " records.\n";
+                return 1;
+            }
+            (header.event == LOG_RECORD_STRING ? strings : formats)[values[0]] = std::move(text);
+            continue;
+        }
+
+        std::vector<std::string> arguments;
+        for (size_t i = 0; i < header.argumentCount; i++) {
+            LogArgumentKind kind = logArgumentKind(header.argumentKinds, i);
+            if (kind == LOG_STRING) {
+                auto found = strings.find(values[i]);
+                arguments.push_back(found != strings.end()
+                                        ? found->second
+                                        : "<string " + std::to_string(values[i]) + ">");
+            } else {
+                arguments.push_back(renderLogNumber(kind, values[i]));
+            }
+        }
+
+        auto format = formats.find(header.event);
+        std::string message
+            = format != formats.end()
+                  ? renderLogFormat(format->second, arguments.data(), arguments.size())
+                  : "<event " + std::to_string(header.event) + ">";
+        printRecord(header, message, arguments, json);
+        records++;
+    }
+    return 0;
+}
+
+// Function to print one event as a text log line or a JSON object
+void printRecord(const LogRecordHeader& header, const std::string& message,
+                 const std::vector<std::string>& arguments, bool json) {
+    const char* level = header.level < sizeof(LOG_LEVEL_NAMES) / sizeof(LOG_LEVEL_NAMES[0])
+                            ? LOG_LEVEL_NAMES[header.level]
+                            : "UNKNOWN";
+    if (!json) {
+        std::cout << "[" << formatTimestamp(header.timestamp) << "] [" << level << "] " << message
+                  << "\n";
+        return;
+    }
+
+    std::cout << "{\"time\":\"" << formatTimestamp(header.timestamp)
+              << "\",\"timestamp_ns\":" << header.timestamp << ",\"level\":\"" << level
+              << "\",\"event\":" << header.event << ",\"message\":\"" << escapeJson(message)
+              << "\",\"args\":[";
+    for (size_t i = 0; i < arguments.size(); i++) {
+        if (i > 0) {
+            std::cout << ",";
+        }
+        if (logArgumentKind(header.argumentKinds, i) == LOG_STRING) {
+            std::cout << "\"" << escapeJson(arguments[i]) << "\"";
+        } else {
+            std::cout << arguments[i];
+        }
+    }
+    std::cout << "]}\n";
+}
+
+// Function to format nanoseconds since the epoch as "YYYY-mm-dd HH:MM:SS.nnnnnnnnn" local time
+std::string formatTimestamp(uint64_t timestamp) {
+    std::tm localTime;
+    toLocalTime(static_cast<std::time_t>(timestamp / 1000000000), localTime);
+    char buffer[48];
+    size_t length = std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &localTime);
+    std::snprintf(buffer + length, sizeof(buffer) - length, ".%09llu",
+                  static_cast<unsigned long long>(timestamp % 1000000000));
+    return buffer;
+}
+
+// Function to escape a string for a JSON string literal
+std::string escapeJson(const std::string& text) {
+    std::string out;
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += static_cast<char>(c);
+        } else if (c < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += static_cast<char>(c);
+        }
+    }
+    return out;
+}
+
+// Function to read a definition's text and skip its padding
+bool readText(std::ifstream& in, uint64_t length, std::string& text) {
+    uint64_t padded = (length + 7) / 8 * 8;
+    if (padded > (1u << 30)) {
+        return false;
+    }
+    std::string buffer(padded, '\0');
+    if (!in.read(buffer.data(), padded)) {
+        return false;
+    }
+    text.assign(buffer, 0, length);
+    return true;
+}
@@ -1,11 +1,56 @@
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <csignal>
+#include <coroutine>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <ctime>
+#include <deque>
+#include <exception>
+#include <filesystem>
 #include <fstream>
+#include <functional>
+#include <initializer_list>
 #include <iomanip>
 #include <iostream>
 #include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define BOOKS_HAVE_IO_URING
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "log_format.h"
 #include "sqlite3.h"
 
 // Constants for menu choices
@@ -14,20 +59,238 @@ const int MENU_VIEW_BOOKS = 2;
 const int MENU_DELETE_BOOK = 3;
 const int MENU_SEARCH_BOOK = 4;
 const int MENU_UPDATE_BOOK = 5;
-const int MENU_QUIT = 6;
+const int MENU_CATALOG_STATS = 6;
+const int MENU_BACKUP = 7;
+const int MENU_TOP_AUTHORS = 8;
+const int MENU_QUIT = 9;
+
+// Constants for search modes, the shortest fuzzy term and how far the fuzzy matcher prefetches
+const int SEARCH_MODE_FUZZY = 2;
+const int SEARCH_MODE_AUTOCOMPLETE = 3;
+const int MAX_FUZZY_DISTANCE = 3;
+const size_t FUZZY_MIN_TERM = 3;
+const size_t FUZZY_PREFETCH_DISTANCE = 8;
+const size_t AUTOCOMPLETE_RESULTS = 10;
+
+// Authors listed by the top authors menu option, and the randomized author_stats check's shape
+const int TOP_AUTHORS_LIMIT = 10;
+const int AUTHOR_STATS_CHECK_ROUNDS = 20;
+const int AUTHOR_STATS_CHECK_OPERATIONS = 50;
+
+// Constants for bulk deletes and updates: rows per transaction and the pause between them that
+// lets other writers in
+const int BULK_CHUNK_ROWS = 1000;
+const int BULK_CHUNK_PAUSE_MS = 5;
+
+// Rows printed per page by book listings; the first page is flushed as soon as it is complete
+const size_t VIEW_PAGE_ROWS = 50;
+
+// Default memory budget of the external sort behind "main export"
+const size_t EXPORT_MEMORY_MB = 64;
+
+// Constants for the parallel scan: rowid chunks queued per worker thread, and the most worker
+// threads accepted per hardware thread
+const size_t SCAN_CHUNKS_PER_THREAD = 8;
+const size_t MAX_THREADS_PER_CORE = 4;
+
+// Constants for the coroutine API: rows fetched per search batch, and the benchmark's readers
+const int ASYNC_SEARCH_BATCH = 256;
+const size_t ASYNC_BENCH_READERS = 2;
+
+// Version of the schema created by ensureSchema, kept in PRAGMA user_version so a database that
+// is already current skips the DDL at startup. Bump it whenever that DDL changes.
+const int SCHEMA_VERSION = 1;
+
+// How long a connection shared with other connections waits for a lock before failing
+const int BUSY_TIMEOUT_MS = 5000;
+
+// The catalog file, which --in-memory loads into RAM at startup and writes back to on exit
+const char* const DATABASE_PATH = "books.db";
+
+// Constants for online backups: pages copied per step and the pause between steps
+const int BACKUP_PAGES_PER_STEP = 64;
+const int BACKUP_STEP_PAUSE_MS = 5;
+
+// Constants for "main check-backup": rows added so the backup takes many steps, the pages per
+// step, and the writes another connection commits meanwhile
+const int BACKUP_CHECK_SEED_ROWS = 20000;
+const int BACKUP_CHECK_PAGES_PER_STEP = 8;
+const int BACKUP_CHECK_WRITES = 200;
+
+// Distinct authors among the books generated by "main seed"
+const int SEED_AUTHORS = 1000;
+
+// Constants for background maintenance: free pages released per incremental vacuum slice, the
+// pause between slices, how many runs pass between ANALYZE passes and the rows ANALYZE samples
+const int MAINTENANCE_VACUUM_PAGES = 256;
+const int MAINTENANCE_SLICE_PAUSE_MS = 20;
+const int MAINTENANCE_ANALYZE_EVERY = 10;
+const int MAINTENANCE_ANALYSIS_LIMIT = 1000;
+const int AUTO_VACUUM_INCREMENTAL = 2;
+
+// Change log written by --capture-changes and read by the "changes" command
+const char* const CHANGE_LOG_PATH = "books.changes";
+const std::string CHANGE_LOG_MAGIC = "BOOKCDC1";
+
+// Changeset log written by --publish-changesets and applied by the "replicate" command
+const char* const CHANGESET_LOG_PATH = "books.changesets";
+const std::string CHANGESET_LOG_MAGIC = "BOOKREP1";
+const size_t REPLICATION_BATCH = 1000;
+
+// Single-row updates made by "main replication-bench" over a leader of this many books
+const int REPLICATION_BENCH_UPDATES = 1000000;
+const int REPLICATION_BENCH_ROWS = 10000;
+
+// Timestamps formatted by each variant of "main log-bench"
+const size_t LOG_BENCH_ITERATIONS = 1000000;
+
+// Queries timed by "main fuzzy-bench", their random seed, and the longest term cut from a book
+const int FUZZY_BENCH_QUERIES = 2000;
+const unsigned FUZZY_BENCH_SEED = 20240601;
+const size_t FUZZY_BENCH_MAX_TERM = 10;
+
+// The io_uring VFS selected by --uring-vfs: ring size, the read-ahead window and the parallel
+// reads it is split into, and how many consecutive reads make a sequential run
+const char* const URING_VFS_NAME = "uring";
+const unsigned URING_QUEUE_DEPTH = 32;
+const size_t URING_WINDOW_BYTES = 256 * 1024;
+const size_t URING_CHUNK_BYTES = 32 * 1024;
+const int URING_SEQUENTIAL_READS = 4;
+const int VFS_BENCH_ROUNDS = 3;
+
+// Text log, opened by the first message
+const char* const LOG_PATH = "book_management.log";
+
+// Binary log written by --binary-log and rendered by logdecode, and how many distinct strings
+// it remembers before starting its intern table over
+const char* const BINARY_LOG_PATH = "book_management.binlog";
+const size_t LOG_INTERN_LIMIT = 4096;
+
+// How often readers that follow a log check for new records
+const int LOG_POLL_MS = 200;
+
+// Metrics written on SIGUSR1 by --metrics, and the upper bounds of the latency histogram
+// buckets in microseconds
+const char* const METRICS_PATH = "book_management.metrics";
+const size_t METRIC_LATENCY_BUCKETS = 6;
+const uint64_t METRIC_LATENCY_BOUNDS_US[METRIC_LATENCY_BUCKETS]
+    = {100, 1000, 10000, 100000, 1000000, 10000000};
+
+// Operations and in-memory caches tracked by the metrics registry
+enum MetricOperation {
+    METRIC_ADD,
+    METRIC_VIEW,
+    METRIC_SEARCH,
+    METRIC_UPDATE,
+    METRIC_DELETE,
+    METRIC_EXPORT,
+    METRIC_BACKUP,
+    METRIC_OPERATION_COUNT
+};
+const char* const METRIC_OPERATION_NAMES[METRIC_OPERATION_COUNT]
+    = {"add", "view", "search", "update", "delete", "export", "backup"};
+enum MetricCache {
+    CACHE_TITLE_FILTER,
+    CACHE_TEXT_SNAPSHOT,
+    CACHE_FUZZY_INDEX,
+    CACHE_PREFIX_INDEX,
+    METRIC_CACHE_COUNT
+};
+const char* const METRIC_CACHE_NAMES[METRIC_CACHE_COUNT]
+    = {"title_filter", "text_snapshot", "fuzzy_index", "prefix_index"};
+
+// Statements of the menu operations, shared with "main explain", which checks their plans
+const char* const INSERT_BOOK_SQL = "INSERT INTO books (title, author) VALUES (?, ?);";
+const char* const TITLE_EXISTS_SQL = "SELECT id FROM books WHERE title = ?;";
+const char* const FETCH_BOOK_SQL = "SELECT title, author FROM books WHERE id = ?;";
+const char* const CHECK_BOOK_SQL = "SELECT 1 FROM books WHERE id = ?;";
+const char* const UPDATE_BOOK_SQL = "UPDATE books SET title = ?, author = ? WHERE id = ?;";
+const char* const DELETE_BOOK_SQL = "DELETE FROM books WHERE id = ?;";
+const char* const FIND_BOOKS_SQL
+    = "SELECT id, title, author FROM books WHERE (title LIKE ?1 OR author LIKE ?1) "
+      "AND id > ?2 ORDER BY id LIMIT ?3;";
+const char* const TOP_AUTHORS_SQL
+    = "SELECT author, book_count FROM author_stats ORDER BY book_count DESC, author LIMIT ?;";
+
+struct Book;
 
 void displayMenu();
 void addBook(sqlite3* db);
 void viewBooks(sqlite3* db);
 void searchBooks(sqlite3* db);
+void likeSearchBooks(sqlite3* db, const std::string& searchTerm);
+bool snapshotSearchBooks(sqlite3* db, const std::string& searchTerm);
+void fuzzySearchBooks(sqlite3* db, const std::string& searchTerm, int maxDistance);
+void autocompleteBooks(sqlite3* db, const std::string& prefix);
+void printBookTableHeader();
 void deleteBook(sqlite3* db);
 void updateBook(sqlite3* db);
+void showCatalogStatistics(sqlite3* db);
+bool ensureSchema(sqlite3* db);
+bool ensureAuthorStats(sqlite3* db);
+int pragmaValue(sqlite3* db, const char* pragma);
+int runBulkOperation(sqlite3* db, const std::vector<std::string>& args, const char* program);
+void showStorageStatistics(sqlite3* db);
+int migrateToIncrementalVacuum(sqlite3* db);
+void listTopAuthors(sqlite3* db, int limit);
+int checkAuthorStats(sqlite3* db, int rounds, unsigned seed);
+int explainStatements(sqlite3* db);
+int seedCatalog(sqlite3* db, int books);
+void backupBooks(sqlite3* db);
+bool backupDatabase(sqlite3* db,
+                    const std::string& destination,
+                    const std::function<void(int, int)>& progress,
+                    int pagesPerStep = BACKUP_PAGES_PER_STEP);
+int checkConcurrentBackup(sqlite3* db, int writes);
+int tailChangeLog(const std::string& path, uint64_t fromSequence, bool follow);
+#ifdef SQLITE_ENABLE_SESSION
+int replicateFollower(sqlite3* leader,
+                      const std::string& followerPath,
+                      bool follow,
+                      const std::string& logPath = CHANGESET_LOG_PATH);
+int benchmarkReplication(int updates);
+#endif
+int runShardCommand(size_t shardCount,
+                    const std::vector<std::string>& args,
+                    const char* program);
+void printBookRow(const Book& book);
+void appendBookRow(std::string& out, const Book& book);
+bool hasLeadingIndex(sqlite3* db, const std::string& column);
+void listBooks(sqlite3* db, const std::string& orderBy, bool descending, int limit);
+std::string listBooksSQL(const std::string& orderBy, bool descending, int limit, bool useHeap);
+int exportBooks(sqlite3* db,
+                const std::string& path,
+                const std::string& orderName,
+                bool descending,
+                size_t memoryBudget);
+int insertBook(sqlite3* db, const std::string& title, const std::string& author);
+bool fetchBook(sqlite3* db, int bookId, Book& book);
+bool changeBook(sqlite3* db,
+                const Book& current,
+                const std::string& newTitle,
+                const std::string& newAuthor);
+bool removeBook(sqlite3* db, const Book& book);
+bool findBooks(sqlite3* db,
+               const std::string& pattern,
+               int afterId,
+               int limit,
+               const std::function<void(const Book&)>& visit);
+int runAsyncBenchmark(const std::string& file, size_t requests, size_t readerThreads);
+int benchmarkLogTimestamps(size_t iterations);
+bool registerUringVfs(bool makeDefault);
+int benchmarkVfs(const std::string& path, int rounds);
+bool timePartitionedScan(sqlite3* db, const std::string& searchTerm, size_t threads);
+int benchmarkFuzzySearch(sqlite3* db, int queries);
+bool parseBookId(const std::string& text, sqlite3_int64& id);
+bool parseThreadCount(const std::string& text, size_t& threads);
+void printUsage(const char* program);
 void handleSqliteError(sqlite3* db, const char* operation);
 bool checkIfExists(sqlite3* db, int bookId);
+bool titleExists(sqlite3* db, const std::string& title);
 int getValidIntegerInput();
 
 // Callback function for querying the database
-static int callback(void* data, int argc, char** argv, char** azColName) {
+static int callback(void*, int argc, char** argv, char**) {
     for (int i = 0; i < argc; i++) {
         if (i > 0) {
             std::cout << " | ";
@@ -39,475 +302,7426 @@ static int callback(void* data, int argc, char** argv, char** azColName) {
     return 0;
 }
 
-// Enum for log levels
+// Enum for log levels, in the order of LOG_LEVEL_NAMES
 enum LogLevel { INFO, WARNING, ERROR, DEBUG };
 
-// Global log file
-std::ofstream logFile("book_management.log");
+// Timestamps for the log without a calendar conversion per message. The wall-clock second is
+// formatted once and cached; within it, the sub-second part is the monotonic clock's offset
+// from the start of that second, so a message costs one steady_clock read and nine digits.
+class LogClock {
+   private:
+    std::chrono::steady_clock::time_point secondStart;
+    std::chrono::steady_clock::time_point secondEnd;
+    uint64_t epochSecond = 0;
+    char prefix[32];
+    size_t prefixLength = 0;
+
+    // Function to re-read the wall clock and format the second that now has started
+    void resync(std::chrono::steady_clock::time_point now) {
+        auto sinceEpoch = std::chrono::system_clock::now().time_since_epoch();
+        auto seconds = std::chrono::duration_cast<std::chrono::seconds>(sinceEpoch);
+        secondStart = now
+                      - std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                          sinceEpoch - seconds);
+        secondEnd = secondStart + std::chrono::seconds(1);
+        epochSecond = static_cast<uint64_t>(seconds.count());
 
-// Function to write log messages
-void writeToLog(LogLevel level, const std::string& message) {
-    std::string levelStr;
-    switch (level) {
-    case INFO:
-        levelStr = "INFO";
-        break;
-    case WARNING:
-        levelStr = "WARNING";
-        break;
-    case ERROR:
-        levelStr = "ERROR";
-        break;
-    case DEBUG:
-        levelStr = "DEBUG";
-        break;
+        std::tm localTime;
+        toLocalTime(static_cast<std::time_t>(seconds.count()), localTime);
+        prefixLength = std::strftime(prefix, sizeof(prefix), "%Y-%m-%d %H:%M:%S", &localTime);
+    }
+
+    // Function to read the monotonic clock and return nanoseconds into the cached second
+    uint64_t tick() {
+        auto now = std::chrono::steady_clock::now();
+        if (prefixLength == 0 || now >= secondEnd || now < secondStart) {
+            resync(now);
+        }
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(now - secondStart).count();
+    }
+
+   public:
+    // Function to append the current time as "YYYY-mm-dd HH:MM:SS.nnnnnnnnn"
+    void append(std::string& out) {
+        uint64_t nanoseconds = tick();
+        out.append(prefix, prefixLength);
+
+        char fraction[10];
+        fraction[0] = '.';
+        for (int i = 9; i > 0; i--) {
+            fraction[i] = static_cast<char>('0' + nanoseconds % 10);
+            nanoseconds /= 10;
+        }
+        out.append(fraction, sizeof(fraction));
+    }
+
+    // Function to return the current time as nanoseconds since the Unix epoch
+    uint64_t nanosecondsSinceEpoch() {
+        uint64_t nanoseconds = tick();
+        return epochSecond * 1000000000 + nanoseconds;
     }
+};
+
+// Structured events, whose numeric arguments the binary log stores without formatting them
+enum LogEventId : uint16_t {
+    LOG_EVENT_MESSAGE = 1,
+    LOG_EVENT_BACKUP_STARTED,
+    LOG_EVENT_BACKUP_FINISHED,
+    LOG_EVENT_MAINTENANCE,
+    LOG_EVENT_EXPORT,
+    LOG_EVENT_LISTING,
+    LOG_EVENT_SNAPSHOT_SCAN,
+    LOG_EVENT_AUTOCOMPLETE_BUILT,
+    LOG_EVENT_COUNT
+};
 
-    std::time_t now = std::time(nullptr);
-    struct tm localTime;
-    localtime_s(&localTime, &now);  // Windows-specific; use localtime() on other platforms
+// Text of each event, indexed by LogEventId; every "{}" takes the next argument
+const char* const LOG_EVENT_FORMATS[LOG_EVENT_COUNT] = {
+    "",
+    "{}",
+    "Scheduled backup to {} started.",
+    "Scheduled backup to {} {} after {} ms.",
+    "Maintenance released {} free pages{} in {} ms.",
+    "Exported {} books by {} to {} in {} ms using {} spilled runs ({} MB).",
+    "Listed {} books by {} {}: first row after {} us, all rows after {} us.",
+    "Scanned {} bytes in {} us ({} GB/s).",
+    "Built autocomplete index: {} keys, {} KiB in {} ms.",
+};
+
+// Argument of a log event: an integer, a real or a string that the binary log interns
+struct LogArgument {
+    LogArgumentKind kind;
+    uint64_t value = 0;
+    std::string_view text;
+
+    template <typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
+    LogArgument(T integer)
+        : kind(LOG_INTEGER), value(static_cast<uint64_t>(static_cast<int64_t>(integer))) {}
+    LogArgument(double real) : kind(LOG_REAL) {
+        std::memcpy(&value, &real, sizeof(value));
+    }
+    LogArgument(std::string_view string) : kind(LOG_STRING), text(string) {}
+    LogArgument(const std::string& string) : kind(LOG_STRING), text(string) {}
+    LogArgument(const char* string) : kind(LOG_STRING), text(string) {}
+};
 
-    logFile << "[" << std::put_time(&localTime, "%Y-%m-%d %H:%M:%S") << "] ";
-    logFile << "[" << levelStr << "] " << message << std::endl;
+// Function to render an event as the line the text log would show for it
+std::string renderLogEvent(LogEventId event, std::initializer_list<LogArgument> arguments) {
+    std::string rendered[LOG_MAX_ARGUMENTS];
+    size_t count = 0;
+    for (const LogArgument& argument : arguments) {
+        if (count == LOG_MAX_ARGUMENTS) {
+            break;
+        }
+        rendered[count++] = argument.kind == LOG_STRING ? std::string(argument.text)
+                                                        : renderLogNumber(argument.kind,
+                                                                          argument.value);
+    }
+    return renderLogFormat(LOG_EVENT_FORMATS[event], rendered, count);
 }
 
-// Class to manage SQLite database connection with RAII(Resource Acquisition Is Initialization)
-class DatabaseConnection {
+// Writer of the binary log described in log_format.h. A record is a fixed 16-byte header and
+// raw 8-byte arguments; strings are written once and then referred to by id, and an event's
+// format is written the first time the event occurs, so logdecode needs nothing but the file.
+class BinaryLogger {
    private:
-    sqlite3* db;
+    std::ofstream out;
+    std::unordered_map<std::string, uint64_t> strings;
+    uint64_t nextString = 0;
+    bool definedEvents[LOG_EVENT_COUNT] = {};
+    std::string record;
+    size_t written = 0;
 
-   public:
-    DatabaseConnection() : db(nullptr) {
-        int rc = sqlite3_open("books.db", &db);
-        if (rc) {
-            std::cerr << "Can't open database: " << sqlite3_errmsg(db) << "\n";
-            throw std::runtime_error("Database connection error");
+    // Function to append a record header to the pending record
+    void appendHeader(uint64_t timestamp, uint16_t event, uint8_t level, size_t count,
+                      uint16_t kinds) {
+        LogRecordHeader header = {timestamp, event, level, static_cast<uint8_t>(count), kinds, 0};
+        record.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+
+    // Function to append one 8-byte argument to the pending record
+    void appendValue(uint64_t value) {
+        record.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    // Function to append a string or event-format definition to the pending record
+    void define(uint16_t kind, uint64_t id, std::string_view text, uint64_t timestamp) {
+        appendHeader(timestamp, kind, 0, 2, 0);
+        appendValue(id);
+        appendValue(text.size());
+        record.append(text);
+        record.append((8 - text.size() % 8) % 8, '\0');
+    }
+
+    // Function to return the id of a string, defining it on first use. Most messages are one
+    // of a kind, so past LOG_INTERN_LIMIT the table starts over rather than growing forever.
+    uint64_t intern(std::string_view text, uint64_t timestamp) {
+        auto found = strings.find(std::string(text));
+        if (found != strings.end()) {
+            return found->second;
         }
+        if (strings.size() >= LOG_INTERN_LIMIT) {
+            strings.clear();
+        }
+        uint64_t id = nextString++;
+        strings.emplace(text, id);
+        define(LOG_RECORD_STRING, id, text, timestamp);
+        return id;
     }
 
-    ~DatabaseConnection() {
-        if (db) {
-            sqlite3_close(db);
+   public:
+    // Function to start a new log file
+    bool open(const std::string& path) {
+        out.open(path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            return false;
         }
+        out.write(BINARY_LOG_MAGIC, sizeof(BINARY_LOG_MAGIC));
+        written = sizeof(BINARY_LOG_MAGIC);
+        return true;
     }
 
-    sqlite3* get() const {
-        return db;
+    bool isOpen() const {
+        return out.is_open();
     }
-};
 
-int main() {
-    try {
-        DatabaseConnection dbConnection;
-        sqlite3* db = dbConnection.get();
+    // Bytes written so far, including definitions and the magic
+    size_t bytesWritten() const {
+        return written;
+    }
 
-        // Create a table to store the book data if it doesn't exist
-        const char* createTableSQL
-            = "CREATE TABLE IF NOT EXISTS books (id INTEGER PRIMARY KEY AUTOINCREMENT, "
-              "title TEXT UNIQUE, author TEXT);";
-        int rc = sqlite3_exec(db, createTableSQL, callback, 0, nullptr);
+    // Function to push buffered records to the file
+    void flush() {
+        out.flush();
+    }
 
-        if (rc != SQLITE_OK) {
-            handleSqliteError(db, "SQL table creation");
-            return 1;
+    // Function to write one event. Unlike the text log, which flushes every line, records stay
+    // buffered until a warning or error is written, the buffer fills or the log is closed.
+    void write(LogLevel level, LogEventId event, std::initializer_list<LogArgument> arguments,
+               uint64_t timestamp) {
+        record.clear();
+        if (!definedEvents[event]) {
+            define(LOG_RECORD_EVENT, event, LOG_EVENT_FORMATS[event], timestamp);
+            definedEvents[event] = true;
         }
 
-        while (true) {
-            displayMenu();
-
-            int choice = getValidIntegerInput();
-
-            switch (choice) {
-            case MENU_ADD_BOOK:
-                writeToLog(INFO, "User selected to add a book.");
-                addBook(db);
-                break;
-            case MENU_VIEW_BOOKS:
-                writeToLog(INFO, "User selected to view books.");
-                viewBooks(db);
-                break;
-            case MENU_DELETE_BOOK:
-                writeToLog(INFO, "User selected to delete a book.");
-                deleteBook(db);
-                break;
-            case MENU_SEARCH_BOOK:
-                writeToLog(INFO, "User selected to search for a book.");
-                searchBooks(db);
-                break;
-            case MENU_UPDATE_BOOK:
-                writeToLog(INFO, "User selected to update a book.");
-                updateBook(db);
-                break;
-            case MENU_QUIT:
-                writeToLog(INFO, "User selected to quit.");
-                // Close the log file
-                logFile.close();
-                // Close the database and exit
-                return 0;
-            default:
-                std::cout << "Invalid choice. Please try again.\n";
+        uint64_t values[LOG_MAX_ARGUMENTS];
+        uint16_t kinds = 0;
+        size_t count = 0;
+        for (const LogArgument& argument : arguments) {
+            if (count == LOG_MAX_ARGUMENTS) {
                 break;
             }
+            kinds |= static_cast<uint16_t>(argument.kind << (2 * count));
+            values[count++]
+                = argument.kind == LOG_STRING ? intern(argument.text, timestamp) : argument.value;
+        }
+        appendHeader(timestamp, event, static_cast<uint8_t>(level), count, kinds);
+        for (size_t i = 0; i < count; i++) {
+            appendValue(values[i]);
         }
-        // Close the log file
-        logFile.close();
 
-        // Close the database and exit
-        return 0;
-    } catch (const std::exception& e) {
-        std::cerr << "An error occurred: " << e.what() << "\n";
-        // Close the log file
-        logFile.close();
-        return 1;
+        out.write(record.data(), record.size());
+        written += record.size();
+        if (level == WARNING || level == ERROR) {
+            out.flush();
+        }
     }
-}
+};
 
-// Function to display the menu
-void displayMenu() {
-    std::cout << "\n*** Book Management System ***\n";
-    std::cout << "1. Add a book\n";
-    std::cout << "2. View all books\n";
-    std::cout << "3. Delete a book\n";
-    std::cout << "4. Search a book\n";
-    std::cout << "5. Update a book\n";
-    std::cout << "6. Quit\n";
-    std::cout << "Enter your choice: ";
+// Global log files, guarded by logMutex together with their clock and line buffer. The text
+// log is opened by the first message rather than at startup, so commands that log nothing never
+// touch it; the binary log is only open when --binary-log is given, and then replaces it.
+std::ofstream logFile;
+bool logFileOpened = false;
+BinaryLogger binaryLog;
+std::mutex logMutex;
+LogClock logClock;
+std::string logLine;
+
+// Function to format a text log line as "[timestamp] [LEVEL] message"
+void formatLogLine(std::string& line, LogClock& clock, LogLevel level, std::string_view message) {
+    line.assign("[");
+    clock.append(line);
+    line += "] [";
+    line += LOG_LEVEL_NAMES[level];
+    line += "] ";
+    line += message;
 }
 
-// Function to add a book to the database
-void addBook(sqlite3* db) {
-    while (true) {
-        std::string title, author;
-        std::cout << "Enter the title of the book: ";
-        std::cin.ignore();
-        std::getline(std::cin, title);
+// Function to write log messages
+void writeToLog(LogLevel level, const std::string& message) {
+    std::lock_guard<std::mutex> lock(logMutex);
+    if (binaryLog.isOpen()) {
+        binaryLog.write(level, LOG_EVENT_MESSAGE, {message}, logClock.nanosecondsSinceEpoch());
+        return;
+    }
+    if (!logFileOpened) {
+        logFile.open(LOG_PATH);
+        logFileOpened = true;
+    }
+    formatLogLine(logLine, logClock, level, message);
+    logFile << logLine << std::endl;
+}
 
-        // Check if a book with the same title already exists
-        const char* checkTitleSQL = "SELECT id FROM books WHERE title = ?;";
-        sqlite3_stmt* checkStmt;
-        int rc = sqlite3_prepare_v2(db, checkTitleSQL, -1, &checkStmt, nullptr);
-        if (rc != SQLITE_OK) {
-            handleSqliteError(db, "prepare statement");
+// Function to log a structured event, rendered to text unless the binary log is open
+void logEvent(LogLevel level, LogEventId event, std::initializer_list<LogArgument> arguments) {
+    {
+        std::lock_guard<std::mutex> lock(logMutex);
+        if (binaryLog.isOpen()) {
+            binaryLog.write(level, event, arguments, logClock.nanosecondsSinceEpoch());
             return;
         }
+    }
+    writeToLog(level, renderLogEvent(event, arguments));
+}
 
-        sqlite3_bind_text(checkStmt, 1, title.c_str(), -1, SQLITE_STATIC);
-        rc = sqlite3_step(checkStmt);
+// Function to close the text log while background jobs may still be writing to it. It stays
+// marked as opened, so their later messages are dropped instead of truncating it on reopen.
+void closeLog() {
+    std::lock_guard<std::mutex> lock(logMutex);
+    logFile.close();
+}
 
-        if (rc == SQLITE_ROW) {
-            std::cout << "A book with the same title already exists in the database.\n";
-            sqlite3_finalize(checkStmt);
-            // Ask if the user wants to add another book
-            char tryAgain;
-            std::cout << "\nDo you want to try again? (y/n): ";
-            std::cin >> tryAgain;
-            if (tryAgain != 'y' && tryAgain != 'Y') {
-                break;  // Return to the main menu
-            }
-        }
+// Class to manage SQLite database connection with RAII(Resource Acquisition Is Initialization)
+class DatabaseConnection {
+   private:
+    sqlite3* db;
+    bool inMemory;
 
-        // If no duplicate title, continue with adding the book
-        std::cout << "Enter the author of the book: ";
-        std::getline(std::cin, author);
+    // Write transactions committed on the in-memory database, counted by a commit hook so
+    // schema and PRAGMA user_version changes count as well as row changes, and the count
+    // covered by the last snapshot
+    std::atomic<uint64_t> commits{0};
+    uint64_t savedCommits = 0;
 
-        // Use parameterized query to insert the book
-        const char* insertSQL = "INSERT INTO books (title, author) VALUES (?, ?);";
-        sqlite3_stmt* stmt;
+    // books.db as this process last read or wrote it, to notice other writers
+    bool diskExists = false;
+    std::filesystem::file_time_type diskWriteTime;
+    uintmax_t diskSize = 0;
+    std::mutex snapshotMutex;
 
-        rc = sqlite3_prepare_v2(db, insertSQL, -1, &stmt, nullptr);
-        if (rc != SQLITE_OK) {
-            handleSqliteError(db, "prepare statement");
-            sqlite3_finalize(checkStmt);
+    // Function to remember the modification time and size of books.db
+    void stampDisk() {
+        std::error_code error;
+        diskWriteTime = std::filesystem::last_write_time(DATABASE_PATH, error);
+        diskExists = !error;
+        diskSize = diskExists ? std::filesystem::file_size(DATABASE_PATH, error) : 0;
+    }
+
+    // Function to check that nobody else wrote books.db since stampDisk
+    bool diskUnchanged() const {
+        std::error_code error;
+        auto writeTime = std::filesystem::last_write_time(DATABASE_PATH, error);
+        if (error) {
+            return !diskExists;
         }
+        return diskExists && writeTime == diskWriteTime
+               && std::filesystem::file_size(DATABASE_PATH, error) == diskSize;
+    }
 
-        sqlite3_bind_text(stmt, 1, title.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 2, author.c_str(), -1, SQLITE_STATIC);
+    // Function to copy books.db into the in-memory database in one backup step; a missing
+    // file leaves it empty, and the first snapshot creates the file
+    bool loadIntoMemory() {
+        stampDisk();
+        sqlite3* disk;
+        if (sqlite3_open_v2(DATABASE_PATH, &disk, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+            sqlite3_close(disk);
+            return true;
+        }
 
-        rc = sqlite3_step(stmt);
+        auto start = std::chrono::steady_clock::now();
+        sqlite3_backup* backup = sqlite3_backup_init(db, "main", disk, "main");
+        int rc = backup ? sqlite3_backup_step(backup, -1) : SQLITE_ERROR;
+        int pages = backup ? sqlite3_backup_pagecount(backup) : 0;
+        sqlite3_backup_finish(backup);
+        sqlite3_close(disk);
         if (rc != SQLITE_DONE) {
-            handleSqliteError(db, "execute statement");
-        } else {
-            std::cout << "Book added successfully.\n";
-            return;
+            handleSqliteError(db, "load database into memory");
+            return false;
         }
 
-        sqlite3_finalize(stmt);
-        sqlite3_finalize(checkStmt);
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start);
+        writeToLog(INFO, "Loaded " + std::to_string(pages) + " pages of " + DATABASE_PATH
+                             + " into memory in " + std::to_string(elapsed.count()) + " ms.");
+        return true;
     }
-}
 
-// Function to view books with sorting
-void viewBooks(sqlite3* db) {
-    // Prompt the user for sorting criteria
-    std::cout << "Select sorting criterion:\n";
-    std::cout << "1. Sort by Title\n";
-    std::cout << "2. Sort by Author\n";
-    std::cout << "Enter your choice: ";
+   public:
+    // Opens books.db, or with inMemory a copy of it in RAM that is written back when closed
+    explicit DatabaseConnection(bool inMemory = false) : db(nullptr), inMemory(inMemory) {
+        // Background jobs share this connection, so it is serialized even when SQLite is built
+        // in multi-thread mode
+        int rc = sqlite3_open_v2(inMemory ? ":memory:" : DATABASE_PATH, &db,
+                                 SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX,
+                                 nullptr);
+        if (rc) {
+            std::cerr << "Can't open database: " << sqlite3_errmsg(db) << "\n";
+            throw std::runtime_error("Database connection error");
+        }
+        if (inMemory && !loadIntoMemory()) {
+            sqlite3_close(db);
+            db = nullptr;
+            throw std::runtime_error("Database load error");
+        }
+        if (inMemory) {
+            sqlite3_commit_hook(
+                db,
+                [](void* counter) {
+                    static_cast<std::atomic<uint64_t>*>(counter)->fetch_add(
+                        1, std::memory_order_relaxed);
+                    return 0;
+                },
+                &commits);
+        }
+    }
 
-    int sortChoice = getValidIntegerInput();
+    ~DatabaseConnection() {
+        if (db) {
+            saveChanges();
+            sqlite3_close(db);
+        }
+    }
 
-    std::string orderBy;
+    bool isInMemory() const {
+        return inMemory;
+    }
 
-    switch (sortChoice) {
-    case 1:
-        orderBy = "title";
-        break;
-    case 2:
-        orderBy = "author";
-        break;
-    default:
-        std::cout << "Invalid choice. Books will not be sorted.\n";
-        break;
+    // Function to write the in-memory database to books.db, replacing the file atomically. By
+    // default it is copied in one step; scheduled snapshots pass BACKUP_PAGES_PER_STEP so the
+    // menu is not held up. Changes other processes made to books.db since it was loaded are not
+    // merged: if the file changed, the snapshot goes to books.db.unsaved instead of overwriting
+    // them, and the user has to reconcile the two.
+    bool snapshot(int pagesPerStep = -1) {
+        std::lock_guard<std::mutex> lock(snapshotMutex);
+        auto start = std::chrono::steady_clock::now();
+        uint64_t committed = commits.load(std::memory_order_relaxed);
+        std::string destination = DATABASE_PATH;
+        bool conflict = !diskUnchanged();
+        if (conflict) {
+            destination += ".unsaved";
+            std::cerr << DATABASE_PATH << " was changed by another process since it was loaded; "
+                      << "writing the in-memory catalog to " << destination << " instead.\n";
+        }
+        bool ok = backupDatabase(db, destination, nullptr, pagesPerStep);
+        if (ok) {
+            savedCommits = committed;
+            if (!conflict) {
+                stampDisk();
+            }
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start);
+        writeToLog(ok && !conflict ? INFO : ERROR,
+                   std::string(ok ? "Wrote" : "Failed to write") + " a snapshot to " + destination
+                       + " in " + std::to_string(elapsed.count()) + " ms.");
+        return ok;
     }
 
-    if (!orderBy.empty()) {
-        // Prompt the user for sorting order
-        std::cout << "Select sorting order:\n";
-        std::cout << "1. Ascending\n";
-        std::cout << "2. Descending\n";
-        std::cout << "Enter your choice: ";
+    // Function to snapshot an in-memory database unless nothing was committed since the last
+    // one, so read-only sessions leave books.db alone
+    bool saveChanges(int pagesPerStep = -1) {
+        if (!inMemory || commits.load(std::memory_order_relaxed) == savedCommits) {
+            return true;
+        }
+        return snapshot(pagesPerStep);
+    }
 
-        int sortOrderChoice = getValidIntegerInput();
+    sqlite3* get() const {
+        return db;
+    }
+};
 
-        std::string sortOrder
-            = (sortOrderChoice == 2) ? "DESC" : "ASC";  // Default to ascending for other choices
+// Function to hint that memory is about to be read; a no-op without the GCC builtin
+void prefetchRead(const void* address) {
+#if defined(__GNUC__)
+    __builtin_prefetch(address);
+#else
+    (void)address;
+#endif
+}
 
-        // View all books in the database with the selected sorting criteria and order
-        std::string selectSQL = "SELECT * FROM books ORDER BY " + orderBy + " " + sortOrder + ";";
+// Function to lower-case a character through a lookup table for the in-memory indexes
+unsigned char foldCase(unsigned char c) {
+    static const std::array<unsigned char, 256> lower = [] {
+        std::array<unsigned char, 256> table{};
+        for (int i = 0; i < 256; i++) {
+            table[i] = static_cast<unsigned char>(std::tolower(i));
+        }
+        return table;
+    }();
+    return lower[c];
+}
 
-        std::cout << std::left << std::setw(8) << "ID";
-        std::cout << " | ";
-        std::cout << std::left << std::setw(24) << "Title";
-        std::cout << " | ";
-        std::cout << std::left << std::setw(16) << "Author"
-                  << "\n";
+// A row of the books table
+struct Book {
+    int id;
+    std::string title;
+    std::string author;
+};
+
+// Result of a fuzzy search: the matching book and its best edit distance
+struct FuzzyMatch {
+    int id;
+    int distance;
+    std::string title;
+    std::string author;
+};
+
+// In-memory bigram index over titles and authors used by the typo-tolerant search mode.
+// Candidates are filtered with the q-gram lemma and verified with Myers' bit-parallel
+// approximate matching, so a query never touches SQLite once the index is built.
+class FuzzyIndex {
+   private:
+    // Titles and authors live back to back in one arena so verification streams through memory
+    struct Entry {
+        int id;
+        bool live;
+        size_t offset;
+        uint32_t titleLength;
+        uint32_t authorLength;
+    };
 
-        std::cout << std::setfill('=') << std::setw(8) << ""
-                  << "=";
-        std::cout << std::setw(26) << ""
-                  << "=";
-        std::cout << std::setw(18) << ""
-                  << "\n";
-        std::cout << std::setfill(' ');
+    std::string arena;
+    std::vector<Entry> entries;
+    std::vector<std::vector<uint32_t>> postings;  // bigram -> field slots, ascending
+    std::unordered_map<int, uint32_t> entryById;
+    size_t deadEntries = 0;
+    bool built = false;
 
-        char* zErrMsg = 0;
-        int rc = sqlite3_exec(db, selectSQL.c_str(), callback, 0, &zErrMsg);
+    // Bigram counts per field slot shared by the searches and zero between them: a search resets
+    // only the slots it touched instead of allocating and clearing a counter for every field.
+    // A byte per slot keeps the counters cache friendly; they stop at the threshold. Sharing
+    // them means searches must not run concurrently, which the single menu thread never does.
+    mutable std::vector<uint8_t> counts;
+    mutable std::vector<uint32_t> touched;
 
-        if (rc != SQLITE_OK) {
-            std::cerr << "SQL error: " << zErrMsg << "\n";
-            sqlite3_free(zErrMsg);
+    static void collectBigrams(const char* text, size_t length, std::vector<uint16_t>& out) {
+        for (size_t i = 1; i < length; i++) {
+            out.push_back(static_cast<uint16_t>(foldCase(text[i - 1]) << 8 | foldCase(text[i])));
         }
     }
-}
 
-// Function to search for books by title or author with parameterized query
-void searchBooks(sqlite3* db) {
-    while (true) {
-        std::string searchTerm;
-        std::cout << "Enter search term (title or author): ";
-        std::cin.ignore();
-        std::getline(std::cin, searchTerm);
+    const char* fieldText(const Entry& entry, uint32_t field) const {
+        return arena.data() + entry.offset + (field ? entry.titleLength : 0);
+    }
+
+    static size_t fieldLength(const Entry& entry, uint32_t field) {
+        return field ? entry.authorLength : entry.titleLength;
+    }
+
+    void append(int id, const std::string& title, const std::string& author) {
+        uint32_t pos = static_cast<uint32_t>(entries.size());
+        entries.push_back({ id,
+                            true,
+                            arena.size(),
+                            static_cast<uint32_t>(title.size()),
+                            static_cast<uint32_t>(author.size()) });
+        arena += title;
+        arena += author;
+        entryById[id] = pos;
+        addPostings(pos);
+    }
+
+    // Postings hold field slots (entry position * 2 + 0 for the title, + 1 for the author) so a
+    // candidate must share enough bigrams within a single field
+    void addPostings(uint32_t pos) {
+        std::vector<uint16_t> bigrams;
+        for (uint32_t field = 0; field < 2; field++) {
+            bigrams.clear();
+            const Entry& entry = entries[pos];
+            collectBigrams(fieldText(entry, field), fieldLength(entry, field), bigrams);
+            std::sort(bigrams.begin(), bigrams.end());
+            bigrams.erase(std::unique(bigrams.begin(), bigrams.end()), bigrams.end());
+            for (uint16_t bigram : bigrams) {
+                postings[bigram].push_back(pos * 2 + field);
+            }
+        }
+    }
+
+    void clear() {
+        arena.clear();
+        entries.clear();
+        entryById.clear();
+        postings.assign(1 << 16, {});
+        deadEntries = 0;
+    }
+
+    // Drop tombstoned entries once they make up half of the index
+    void compact() {
+        std::string oldArena;
+        std::vector<Entry> oldEntries;
+        oldArena.swap(arena);
+        oldEntries.swap(entries);
+        clear();
+        for (const Entry& entry : oldEntries) {
+            if (entry.live) {
+                append(entry.id,
+                       oldArena.substr(entry.offset, entry.titleLength),
+                       oldArena.substr(entry.offset + entry.titleLength, entry.authorLength));
+            }
+        }
+    }
 
-        // Construct a SQL query to search for books with parameterized query
-        const char* searchSQL = "SELECT * FROM books WHERE title LIKE ? OR author LIKE ?;";
+    // Smallest edit distance between the pattern and any substring of the text (Myers, 1999).
+    // peq is indexed by the raw text byte and already folds case. Patterns longer than 64
+    // characters fall back to the classic dynamic program.
+    static int bestDistance(const std::string& pattern,
+                            const std::array<uint64_t, 256>& peq,
+                            const char* text,
+                            size_t length) {
+        const size_t m = pattern.size();
+        if (m == 0) {
+            return 0;
+        }
+        if (m > 64) {
+            std::vector<int> column(m + 1);
+            for (size_t i = 0; i <= m; i++) {
+                column[i] = static_cast<int>(i);
+            }
+            int best = column[m];
+            for (size_t j = 0; j < length; j++) {
+                int diagonal = column[0];
+                for (size_t i = 1; i <= m; i++) {
+                    int above = column[i];
+                    int cost = foldCase(pattern[i - 1]) == foldCase(text[j]) ? 0 : 1;
+                    column[i] = std::min({ above + 1, column[i - 1] + 1, diagonal + cost });
+                    diagonal = above;
+                }
+                best = std::min(best, column[m]);
+            }
+            return best;
+        }
+
+        const uint64_t last = uint64_t(1) << (m - 1);
+        uint64_t pv = ~uint64_t(0);
+        uint64_t mv = 0;
+        int score = static_cast<int>(m);
+        int best = score;
+        for (size_t j = 0; j < length; j++) {
+            uint64_t eq = peq[static_cast<unsigned char>(text[j])];
+            uint64_t xv = eq | mv;
+            uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+            uint64_t ph = mv | ~(xh | pv);
+            uint64_t mh = pv & xh;
+            score += ((ph & last) != 0) - ((mh & last) != 0);
+            ph <<= 1;
+            mh <<= 1;
+            pv = mh | ~(xv | ph);
+            mv = ph & xv;
+            best = std::min(best, score);
+        }
+        return best;
+    }
+
+#if defined(__GNUC__) && defined(__x86_64__)
+    // Function to run the bit-parallel matcher over four texts at once, one per 64-bit lane, for
+    // patterns of 1 to 64 characters. A lane past the end of its text reads a character matching
+    // nothing, which never lowers its best distance.
+    __attribute__((target("avx2"))) static void bestDistancesAvx2(
+        size_t m, const std::array<uint64_t, 256>& peq, const char* const* texts,
+        const size_t* lengths, int* best) {
+        const __m256i ones = _mm256_set1_epi64x(-1);
+        const __m256i last = _mm256_set1_epi64x(static_cast<long long>(uint64_t(1) << (m - 1)));
+        __m256i pv = ones;
+        __m256i mv = _mm256_setzero_si256();
+        __m256i score = _mm256_set1_epi64x(static_cast<long long>(m));
+        __m256i lowest = score;
+        size_t longest = *std::max_element(lengths, lengths + 4);
+        auto lane = [&](int k, size_t j) {
+            return j < lengths[k]
+                       ? static_cast<long long>(peq[static_cast<unsigned char>(texts[k][j])])
+                       : 0;
+        };
+        for (size_t j = 0; j < longest; j++) {
+            __m256i eq = _mm256_set_epi64x(lane(3, j), lane(2, j), lane(1, j), lane(0, j));
+            __m256i xv = _mm256_or_si256(eq, mv);
+            __m256i xh = _mm256_or_si256(
+                _mm256_xor_si256(_mm256_add_epi64(_mm256_and_si256(eq, pv), pv), pv), eq);
+            __m256i ph = _mm256_or_si256(mv, _mm256_xor_si256(_mm256_or_si256(xh, pv), ones));
+            __m256i mh = _mm256_and_si256(pv, xh);
+            // The comparisons yield -1 in the lanes whose last row moves up or down
+            score = _mm256_sub_epi64(score,
+                                     _mm256_cmpeq_epi64(_mm256_and_si256(ph, last), last));
+            score = _mm256_add_epi64(score,
+                                     _mm256_cmpeq_epi64(_mm256_and_si256(mh, last), last));
+            ph = _mm256_slli_epi64(ph, 1);
+            mh = _mm256_slli_epi64(mh, 1);
+            pv = _mm256_or_si256(mh, _mm256_xor_si256(_mm256_or_si256(xv, ph), ones));
+            mv = _mm256_and_si256(ph, xv);
+            lowest = _mm256_blendv_epi8(lowest, score, _mm256_cmpgt_epi64(lowest, score));
+        }
+        alignas(32) long long lanes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), lowest);
+        for (int k = 0; k < 4; k++) {
+            best[k] = static_cast<int>(lanes[k]);
+        }
+    }
+#endif
+
+   public:
+    bool isBuilt() const {
+        return built;
+    }
+
+    // Load every book from the database into the index
+    bool build(sqlite3* db) {
+        const char* selectSQL = "SELECT id, title, author FROM books;";
         sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(db, selectSQL, -1, &stmt, nullptr) != SQLITE_OK) {
+            return false;
+        }
 
-        int rc = sqlite3_prepare_v2(db, searchSQL, -1, &stmt, nullptr);
-        if (rc != SQLITE_OK) {
-            handleSqliteError(db, "prepare statement");
+        clear();
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            const unsigned char* title = sqlite3_column_text(stmt, 1);
+            const unsigned char* author = sqlite3_column_text(stmt, 2);
+            append(sqlite3_column_int(stmt, 0),
+                   title ? reinterpret_cast<const char*>(title) : "",
+                   author ? reinterpret_cast<const char*>(author) : "");
+        }
+        sqlite3_finalize(stmt);
+        if (rc != SQLITE_DONE) {
+            clear();
+            return false;
+        }
+
+        built = true;
+        return true;
+    }
+
+    void add(int id, const std::string& title, const std::string& author) {
+        remove(id);
+        append(id, title, author);
+    }
+
+    void remove(int id) {
+        auto it = entryById.find(id);
+        if (it == entryById.end()) {
             return;
         }
+        entries[it->second].live = false;
+        entryById.erase(it);
+        if (++deadEntries > entries.size() / 2) {
+            compact();
+        }
+    }
 
-        // Bind the search term to the parameter
-        sqlite3_bind_text(stmt, 1, ("%" + searchTerm + "%").c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 2, ("%" + searchTerm + "%").c_str(), -1, SQLITE_STATIC);
+    // Find books whose title or author contains the pattern with at most maxDistance edits
+    std::vector<FuzzyMatch> search(const std::string& pattern, int maxDistance) const {
+        // Shorter terms allow no typo and would match most books
+        if (pattern.size() < FUZZY_MIN_TERM) {
+            return {};
+        }
 
-        // Display header
-        std::cout << "Search Results:\n";
-        std::cout << std::left << std::setw(8) << "ID";
-        std::cout << " | ";
-        std::cout << std::left << std::setw(24) << "Title";
-        std::cout << " | ";
-        std::cout << std::left << std::setw(16) << "Author"
-                  << "\n";
-
-        std::cout << std::setfill('=') << std::setw(8) << ""
-                  << "=";
-        std::cout << std::setw(26) << ""
-                  << "=";
-        std::cout << std::setw(18) << ""
-                  << "\n";
-        std::cout << std::setfill(' ');
-
-        // Step through the prepared statement and print results row by row
-        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
-            std::cout << std::left << std::setw(8) << sqlite3_column_int(stmt, 0);
-            std::cout << " | ";
-            std::cout << std::left << std::setw(24)
-                      << reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-            std::cout << " | ";
-            std::cout << std::left << std::setw(16)
-                      << reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2)) << "\n";
+        // Every byte that folds to a pattern character matches it, so the scan needs no folding
+        std::array<uint64_t, 256> peq{};
+        for (size_t i = 0; i < pattern.size() && i < 64; i++) {
+            peq[foldCase(pattern[i])] |= uint64_t(1) << i;
+        }
+        for (int c = 0; c < 256; c++) {
+            peq[c] = peq[foldCase(static_cast<unsigned char>(c))];
         }
 
-        if (rc != SQLITE_DONE) {
-            handleSqliteError(db, "execute statement");
+        std::vector<uint16_t> bigrams;
+        collectBigrams(pattern.data(), pattern.size(), bigrams);
+        std::sort(bigrams.begin(), bigrams.end());
+        bigrams.erase(std::unique(bigrams.begin(), bigrams.end()), bigrams.end());
+
+        // Each edit destroys at most two bigrams, so a match must share the rest with the text.
+        // Typos are capped at one per three characters after the first, and so that two bigrams
+        // are left to filter on, as a single common one already selects much of the catalog.
+        const int distinct = static_cast<int>(bigrams.size());
+        maxDistance = std::min({ maxDistance,
+                                 (static_cast<int>(pattern.size()) - 1) / 3,
+                                 std::max(distinct - 2, 0) / 2 });
+        const int threshold = std::min(distinct - 2 * maxDistance, UINT8_MAX);
+
+        counts.resize(std::max(counts.size(), entries.size() * 2));
+        std::vector<uint32_t> candidates;
+        for (uint16_t bigram : bigrams) {
+            for (uint32_t slot : postings[bigram]) {
+                uint8_t& count = counts[slot];
+                if (count == 0) {
+                    touched.push_back(slot);
+                }
+                if (count < threshold && ++count == threshold) {
+                    candidates.push_back(slot);
+                }
+            }
+        }
+        for (uint32_t slot : touched) {
+            counts[slot] = 0;
         }
+        touched.clear();
+        std::sort(candidates.begin(), candidates.end());
 
-        sqlite3_finalize(stmt);
+        // Candidates are scattered over the arena, so fetching starts a few ahead of the matcher
+        auto prefetch = [this, &candidates](size_t i) {
+            if (i + FUZZY_PREFETCH_DISTANCE < candidates.size()) {
+                const Entry& ahead = entries[candidates[i + FUZZY_PREFETCH_DISTANCE] / 2];
+                prefetchRead(arena.data() + ahead.offset);
+            }
+            if (i + 2 * FUZZY_PREFETCH_DISTANCE < candidates.size()) {
+                prefetchRead(&entries[candidates[i + 2 * FUZZY_PREFETCH_DISTANCE] / 2]);
+            }
+        };
+        std::vector<int> distances(candidates.size());
+        size_t verified = 0;
+#if defined(__GNUC__) && defined(__x86_64__)
+        if (pattern.size() <= 64 && __builtin_cpu_supports("avx2")) {
+            for (; verified + 4 <= candidates.size(); verified += 4) {
+                const char* texts[4];
+                size_t lengths[4];
+                for (size_t k = 0; k < 4; k++) {
+                    prefetch(verified + k);
+                    uint32_t slot = candidates[verified + k];
+                    texts[k] = fieldText(entries[slot / 2], slot % 2);
+                    lengths[k] = fieldLength(entries[slot / 2], slot % 2);
+                }
+                bestDistancesAvx2(pattern.size(), peq, texts, lengths, &distances[verified]);
+            }
+        }
+#endif
+        for (; verified < candidates.size(); verified++) {
+            prefetch(verified);
+            uint32_t slot = candidates[verified];
+            const Entry& entry = entries[slot / 2];
+            distances[verified] = bestDistance(
+                pattern, peq, fieldText(entry, slot % 2), fieldLength(entry, slot % 2));
+        }
 
-        // Ask if the user wants to search again
-        char tryAgain;
-        std::cout << "\nDo you want to search again? (y/n): ";
-        std::cin >> tryAgain;
-        if (tryAgain != 'y' && tryAgain != 'Y') {
-            break;  // Return to the main menu
+        // Candidates are sorted, so both fields of an entry are checked back to back
+        std::vector<FuzzyMatch> matches;
+        for (size_t i = 0; i < candidates.size(); i++) {
+            const Entry& entry = entries[candidates[i] / 2];
+            int distance = distances[i];
+            if (!entry.live || distance > maxDistance) {
+                continue;
+            }
+            if (!matches.empty() && matches.back().id == entry.id) {
+                matches.back().distance = std::min(matches.back().distance, distance);
+            } else {
+                matches.push_back({ entry.id,
+                                    distance,
+                                    std::string(fieldText(entry, 0), entry.titleLength),
+                                    std::string(fieldText(entry, 1), entry.authorLength) });
+            }
         }
+
+        std::sort(matches.begin(), matches.end(), [](const FuzzyMatch& a, const FuzzyMatch& b) {
+            return a.distance != b.distance ? a.distance < b.distance : a.id < b.id;
+        });
+        return matches;
     }
-}
+};
 
-// Function to delete a book from the database
-void deleteBook(sqlite3* db) {
-    std::cout << "Enter the ID of the book you want to delete: ";
-    int bookId = getValidIntegerInput();
+// A distinct title or author offered by the autocomplete, ranked by how many books carry it
+struct Completion {
+    std::string text;
+    bool isAuthor;
+    uint32_t books;
+};
 
-    // Retrieve the title and author information based on the book ID
-    std::string title, author;
-    const char* selectSQL = "SELECT title, author FROM books WHERE id = ?;";
-    sqlite3_stmt* selectStmt;
+// In-memory prefix index over distinct titles and authors for type-ahead search. Keys live in
+// a large sorted run with a max segment tree over book counts, so the top-k completions of a
+// prefix are found in O(log n + k log n). New keys go to a small sorted run that is merged
+// into the large one once it grows, which keeps writes cheap.
+class PrefixIndex {
+   private:
+    static const size_t MAX_RECENT = 4096;
 
-    int rc = sqlite3_prepare_v2(db, selectSQL, -1, &selectStmt, nullptr);
-    if (rc != SQLITE_OK) {
-        handleSqliteError(db, "prepare statement");
-        return;
+    std::vector<Completion> sorted;
+    std::vector<uint32_t> maxTree;  // implicit tree over sorted, each node holds its argmax
+    size_t leaves = 0;
+    std::vector<Completion> recent;
+    bool built = false;
+
+    // Case-insensitive ordering, comparing at most limit characters
+    static int compareFolded(const std::string& a, const std::string& b, size_t limit) {
+        size_t n = std::min({ a.size(), b.size(), limit });
+        for (size_t i = 0; i < n; i++) {
+            unsigned char ca = foldCase(a[i]);
+            unsigned char cb = foldCase(b[i]);
+            if (ca != cb) {
+                return ca < cb ? -1 : 1;
+            }
+        }
+        size_t la = std::min(a.size(), limit);
+        size_t lb = std::min(b.size(), limit);
+        return la == lb ? 0 : (la < lb ? -1 : 1);
     }
 
-    sqlite3_bind_int(selectStmt, 1, bookId);
+    static bool keyLess(const Completion& a, const Completion& b) {
+        int cmp = compareFolded(a.text, b.text, std::string::npos);
+        return cmp != 0 ? cmp < 0 : a.isAuthor < b.isAuthor;
+    }
 
-    rc = sqlite3_step(selectStmt);
-    if (rc == SQLITE_ROW) {
-        title = reinterpret_cast<const char*>(sqlite3_column_text(selectStmt, 0));
-        author = reinterpret_cast<const char*>(sqlite3_column_text(selectStmt, 1));
+    static bool betterThan(const Completion& a, const Completion& b) {
+        return a.books != b.books ? a.books > b.books : keyLess(a, b);
     }
 
-    sqlite3_finalize(selectStmt);
+    uint32_t better(uint32_t a, uint32_t b) const {
+        if (a >= sorted.size()) {
+            return b;
+        }
+        if (b >= sorted.size()) {
+            return a;
+        }
+        return betterThan(sorted[b], sorted[a]) ? b : a;
+    }
 
-    // Ask for confirmation before deleting the book
-    std::cout << "You are about to delete the following book:\n";
-    std::cout << "Title: " << title << "\n";
-    std::cout << "Author: " << author << "\n";
+    void rebuildTree() {
+        leaves = 1;
+        while (leaves < sorted.size()) {
+            leaves <<= 1;
+        }
+        maxTree.assign(2 * leaves, UINT32_MAX);
+        for (size_t i = 0; i < sorted.size(); i++) {
+            maxTree[leaves + i] = static_cast<uint32_t>(i);
+        }
+        for (size_t node = leaves - 1; node > 0; node--) {
+            maxTree[node] = better(maxTree[2 * node], maxTree[2 * node + 1]);
+        }
+    }
 
-    char confirm;
-    std::cout << "Are you sure you want to delete this book? (y/n): ";
-    std::cin >> confirm;
+    void updateTree(size_t pos) {
+        for (size_t node = (leaves + pos) / 2; node > 0; node /= 2) {
+            maxTree[node] = better(maxTree[2 * node], maxTree[2 * node + 1]);
+        }
+    }
 
-    if (confirm == 'y' || confirm == 'Y') {
-        // Use parameterized query to delete the book
-        const char* deleteSQL = "DELETE FROM books WHERE id = ?;";
-        sqlite3_stmt* deleteStmt;
+    // Position of the best key in sorted[first, last)
+    uint32_t argmax(size_t first, size_t last) const {
+        uint32_t best = UINT32_MAX;
+        for (first += leaves, last += leaves; first < last; first /= 2, last /= 2) {
+            if (first & 1) {
+                best = better(best, maxTree[first++]);
+            }
+            if (last & 1) {
+                best = better(best, maxTree[--last]);
+            }
+        }
+        return best;
+    }
 
-        rc = sqlite3_prepare_v2(db, deleteSQL, -1, &deleteStmt, nullptr);
-        if (rc != SQLITE_OK) {
-            handleSqliteError(db, "prepare statement");
+    // Range of keys in a sorted run that start with the prefix
+    static std::pair<size_t, size_t> prefixRange(const std::vector<Completion>& run,
+                                                 const std::string& prefix) {
+        auto first = std::lower_bound(
+            run.begin(), run.end(), prefix, [](const Completion& c, const std::string& p) {
+                return compareFolded(c.text, p, p.size()) < 0;
+            });
+        auto last = std::upper_bound(
+            first, run.end(), prefix, [](const std::string& p, const Completion& c) {
+                return compareFolded(p, c.text, p.size()) < 0;
+            });
+        return { first - run.begin(), last - run.begin() };
+    }
+
+    void mergeRecent() {
+        std::vector<Completion> merged;
+        merged.reserve(sorted.size() + recent.size());
+        std::merge(std::make_move_iterator(sorted.begin()),
+                   std::make_move_iterator(sorted.end()),
+                   std::make_move_iterator(recent.begin()),
+                   std::make_move_iterator(recent.end()),
+                   std::back_inserter(merged),
+                   keyLess);
+        merged.erase(std::remove_if(merged.begin(),
+                                    merged.end(),
+                                    [](const Completion& c) { return c.books == 0; }),
+                     merged.end());
+        sorted.swap(merged);
+        recent.clear();
+        rebuildTree();
+    }
+
+    static uint32_t addClamped(uint32_t books, int delta) {
+        return delta < 0 && books < static_cast<uint32_t>(-delta) ? 0 : books + delta;
+    }
+
+    void adjust(const std::string& text, bool isAuthor, int delta) {
+        if (text.empty()) {
+            return;
+        }
+        Completion key{ text, isAuthor, 0 };
+        auto it = std::lower_bound(sorted.begin(), sorted.end(), key, keyLess);
+        if (it != sorted.end() && !keyLess(key, *it)) {
+            it->books = addClamped(it->books, delta);
+            updateTree(it - sorted.begin());
             return;
         }
+        auto rit = std::lower_bound(recent.begin(), recent.end(), key, keyLess);
+        if (rit != recent.end() && !keyLess(key, *rit)) {
+            rit->books = addClamped(rit->books, delta);
+        } else if (delta > 0) {
+            key.books = delta;
+            recent.insert(rit, std::move(key));
+            if (recent.size() > MAX_RECENT) {
+                mergeRecent();
+            }
+        }
+    }
+
+   public:
+    bool isBuilt() const {
+        return built;
+    }
 
-        sqlite3_bind_int(deleteStmt, 1, bookId);
+    // Load the distinct titles and authors with their book counts
+    bool build(sqlite3* db) {
+        const char* selectSQL
+            = "SELECT title, 0, COUNT(*) FROM books WHERE title <> '' GROUP BY title "
+              "UNION ALL SELECT author, 1, COUNT(*) FROM books WHERE author <> '' GROUP BY author;";
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(db, selectSQL, -1, &stmt, nullptr) != SQLITE_OK) {
+            return false;
+        }
 
-        rc = sqlite3_step(deleteStmt);
+        sorted.clear();
+        recent.clear();
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            sorted.push_back({ reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)),
+                               sqlite3_column_int(stmt, 1) != 0,
+                               static_cast<uint32_t>(sqlite3_column_int(stmt, 2)) });
+        }
+        sqlite3_finalize(stmt);
         if (rc != SQLITE_DONE) {
-            handleSqliteError(db, "execute statement");
-        } else {
-            std::cout << "Book deleted successfully.\n";
+            sorted.clear();
+            return false;
         }
 
-        sqlite3_finalize(deleteStmt);
-    } else {
-        std::cout << "Deletion canceled.\n";
+        // Keys differing only in case share one entry under the first spelling seen
+        std::stable_sort(sorted.begin(), sorted.end(), keyLess);
+        size_t out = 0;
+        for (size_t i = 0; i < sorted.size(); i++) {
+            if (out > 0 && !keyLess(sorted[out - 1], sorted[i])) {
+                sorted[out - 1].books += sorted[i].books;
+            } else if (out++ != i) {
+                sorted[out - 1] = std::move(sorted[i]);
+            }
+        }
+        sorted.resize(out);
+        rebuildTree();
+        built = true;
+        return true;
+    }
+
+    void add(const std::string& title, const std::string& author) {
+        adjust(title, false, 1);
+        adjust(author, true, 1);
+    }
+
+    void remove(const std::string& title, const std::string& author) {
+        adjust(title, false, -1);
+        adjust(author, true, -1);
+    }
+
+    // The k most popular titles and authors starting with the prefix
+    std::vector<Completion> complete(const std::string& prefix, size_t k) const {
+        std::vector<Completion> results;
+
+        // Pop the best key of a range and split the range around it, best ranges first
+        auto rangeLess = [this](const std::pair<uint32_t, std::pair<size_t, size_t>>& a,
+                                const std::pair<uint32_t, std::pair<size_t, size_t>>& b) {
+            return betterThan(sorted[b.first], sorted[a.first]);
+        };
+        std::vector<std::pair<uint32_t, std::pair<size_t, size_t>>> heap;
+        auto pushRange = [&](size_t first, size_t last) {
+            if (first < last) {
+                heap.push_back({ argmax(first, last), { first, last } });
+                std::push_heap(heap.begin(), heap.end(), rangeLess);
+            }
+        };
+
+        auto range = prefixRange(sorted, prefix);
+        pushRange(range.first, range.second);
+        while (!heap.empty() && results.size() < k) {
+            std::pop_heap(heap.begin(), heap.end(), rangeLess);
+            auto top = heap.back();
+            heap.pop_back();
+            if (sorted[top.first].books == 0) {
+                break;
+            }
+            results.push_back(sorted[top.first]);
+            pushRange(top.second.first, top.first);
+            pushRange(top.first + 1, top.second.second);
+        }
+
+        range = prefixRange(recent, prefix);
+        for (size_t i = range.first; i < range.second; i++) {
+            if (recent[i].books > 0) {
+                results.push_back(recent[i]);
+            }
+        }
+
+        std::sort(results.begin(), results.end(), betterThan);
+        if (results.size() > k) {
+            results.resize(k);
+        }
+        return results;
     }
+
+    size_t size() const {
+        return sorted.size() + recent.size();
+    }
+
+    // Approximate heap footprint of the index in bytes
+    size_t memoryUsage() const {
+        size_t bytes = maxTree.capacity() * sizeof(uint32_t);
+        for (const std::vector<Completion>* run : { &sorted, &recent }) {
+            bytes += run->capacity() * sizeof(Completion);
+            for (const Completion& c : *run) {
+                if (c.text.capacity() > 15) {  // beyond the small-string buffer
+                    bytes += c.text.capacity() + 1;
+                }
+            }
+        }
+        return bytes;
+    }
+};
+
+// Case-insensitive substring scan kernels for the text snapshot. Each returns the offset of the
+// first occurrence of the lower-cased needle in text[from, length), or std::string::npos.
+// Candidates are found by comparing the needle's first and last characters a block at a time;
+// letters compare with bit 0x20 forced on, which folds ASCII case exactly.
+size_t findFoldedScalar(const char* text, size_t length, const std::string& needle, size_t from) {
+    const size_t m = needle.size();
+    for (size_t i = from; i + m <= length; i++) {
+        size_t j = 0;
+        while (j < m && foldCase(text[i + j]) == static_cast<unsigned char>(needle[j])) {
+            j++;
+        }
+        if (j == m) {
+            return i;
+        }
+    }
+    return std::string::npos;
 }
 
-// Function to update a book in the database
-void updateBook(sqlite3* db) {
-    std::cout << "Enter the ID of the book you want to update: ";
-    int bookId = getValidIntegerInput();
+bool matchesFoldedAt(const char* text, const std::string& needle, size_t pos) {
+    for (size_t j = 1; j + 1 < needle.size(); j++) {
+        if (foldCase(text[pos + j]) != static_cast<unsigned char>(needle[j])) {
+            return false;
+        }
+    }
+    return true;
+}
 
-    // Check if the book with the specified ID exists
-    if (!checkIfExists(db, bookId)) {
-        std::cout << "Book with ID " << bookId << " does not exist in the database.\n";
-        return;
+#if defined(__GNUC__) && defined(__x86_64__)
+size_t findFoldedSse2(const char* text, size_t length, const std::string& needle, size_t from) {
+    const size_t m = needle.size();
+    // Unsigned, as std::isalpha is undefined for the negative chars of non-ASCII bytes
+    const unsigned char firstChar = needle.front(), lastChar = needle.back();
+    const __m128i first = _mm_set1_epi8(firstChar);
+    const __m128i last = _mm_set1_epi8(lastChar);
+    const __m128i firstCase = _mm_set1_epi8(std::isalpha(firstChar) ? 0x20 : 0);
+    const __m128i lastCase = _mm_set1_epi8(std::isalpha(lastChar) ? 0x20 : 0);
+
+    size_t i = from;
+    for (; i + m - 1 + 16 <= length; i += 16) {
+        __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + m - 1));
+        __m128i eqFirst = _mm_cmpeq_epi8(_mm_or_si128(blockFirst, firstCase), first);
+        __m128i eqLast = _mm_cmpeq_epi8(_mm_or_si128(blockLast, lastCase), last);
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_and_si128(eqFirst, eqLast)));
+        while (mask) {
+            unsigned bit = __builtin_ctz(mask);
+            if (matchesFoldedAt(text, needle, i + bit)) {
+                return i + bit;
+            }
+            mask &= mask - 1;
+        }
     }
+    return findFoldedScalar(text, length, needle, i);
+}
 
-    // Retrieve the current title and author information based on the book ID
-    std::string currentTitle, currentAuthor;
-    const char* selectSQL = "SELECT title, author FROM books WHERE id = ?;";
-    sqlite3_stmt* selectStmt;
+__attribute__((target("avx2"))) size_t findFoldedAvx2(const char* text,
+                                                       size_t length,
+                                                       const std::string& needle,
+                                                       size_t from) {
+    const size_t m = needle.size();
+    const unsigned char firstChar = needle.front(), lastChar = needle.back();
+    const __m256i first = _mm256_set1_epi8(firstChar);
+    const __m256i last = _mm256_set1_epi8(lastChar);
+    const __m256i firstCase = _mm256_set1_epi8(std::isalpha(firstChar) ? 0x20 : 0);
+    const __m256i lastCase = _mm256_set1_epi8(std::isalpha(lastChar) ? 0x20 : 0);
 
-    int rc = sqlite3_prepare_v2(db, selectSQL, -1, &selectStmt, nullptr);
-    if (rc != SQLITE_OK) {
-        handleSqliteError(db, "prepare statement");
-        return;
+    size_t i = from;
+    for (; i + m - 1 + 32 <= length; i += 32) {
+        __m256i blockFirst = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i));
+        __m256i blockLast
+            = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i + m - 1));
+        __m256i eqFirst = _mm256_cmpeq_epi8(_mm256_or_si256(blockFirst, firstCase), first);
+        __m256i eqLast = _mm256_cmpeq_epi8(_mm256_or_si256(blockLast, lastCase), last);
+        unsigned mask
+            = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_and_si256(eqFirst, eqLast)));
+        while (mask) {
+            unsigned bit = __builtin_ctz(mask);
+            if (matchesFoldedAt(text, needle, i + bit)) {
+                return i + bit;
+            }
+            mask &= mask - 1;
+        }
     }
+    return findFoldedScalar(text, length, needle, i);
+}
+#endif
 
-    sqlite3_bind_int(selectStmt, 1, bookId);
+using FindFoldedKernel = size_t (*)(const char*, size_t, const std::string&, size_t);
 
-    rc = sqlite3_step(selectStmt);
-    if (rc == SQLITE_ROW) {
-        currentTitle = reinterpret_cast<const char*>(sqlite3_column_text(selectStmt, 0));
-        currentAuthor = reinterpret_cast<const char*>(sqlite3_column_text(selectStmt, 1));
+// Function to pick the widest scan kernel the CPU supports
+FindFoldedKernel selectFindFoldedKernel() {
+#if defined(__GNUC__) && defined(__x86_64__)
+    if (__builtin_cpu_supports("avx2")) {
+        return findFoldedAvx2;
     }
+    return findFoldedSse2;
+#else
+    return findFoldedScalar;
+#endif
+}
 
-    sqlite3_finalize(selectStmt);
+// Contiguous in-memory copy of every title and author for searches that cannot use an index.
+// Each book is stored as "title\0author\0", so a match never spans two fields; deleted books
+// are zeroed in place and the arena is compacted once half of it is dead.
+class TextSnapshot {
+   private:
+    struct Record {
+        int id;
+        size_t offset;
+        size_t length;
+    };
 
-    std::string newTitle, newAuthor;
-    std::cout
-        << "Enter the new title of the book (or press Enter to keep it unchanged, current title: "
-        << currentTitle << "): ";
-    std::cin.ignore();
-    std::getline(std::cin, newTitle);
+    std::string arena;
+    std::vector<Record> records;  // ascending offset
+    std::unordered_map<int, size_t> recordById;
+    size_t deadBytes = 0;
+    bool built = false;
 
-    if (newTitle.empty()) {
-        newTitle = currentTitle;  // Keep the current title if the user presses Enter
+    void append(int id, const std::string& title, const std::string& author) {
+        Record record{ id, arena.size(), title.size() + author.size() + 2 };
+        arena += title;
+        arena += '\0';
+        arena += author;
+        arena += '\0';
+        recordById[id] = records.size();
+        records.push_back(record);
     }
 
-    std::cout
-        << "Enter the new author of the book (or press Enter to keep it unchanged, current author: "
-        << currentAuthor << "): ";
-    std::getline(std::cin, newAuthor);
+    void compact() {
+        std::string oldArena;
+        std::vector<Record> oldRecords;
+        oldArena.swap(arena);
+        oldRecords.swap(records);
+        recordById.clear();
+        deadBytes = 0;
+        for (const Record& record : oldRecords) {
+            if (record.id != 0) {
+                recordById[record.id] = records.size();
+                records.push_back({ record.id, arena.size(), record.length });
+                arena.append(oldArena, record.offset, record.length);
+            }
+        }
+    }
 
-    if (newAuthor.empty()) {
-        newAuthor = currentAuthor;  // Keep the current author if the user presses Enter
+   public:
+    bool isBuilt() const {
+        return built;
     }
 
-    // Use parameterized query to update the book
-    const char* updateSQL = "UPDATE books SET title = ?, author = ? WHERE id = ?;";
-    sqlite3_stmt* updateStmt;
+    size_t bytes() const {
+        return arena.size();
+    }
 
-    rc = sqlite3_prepare_v2(db, updateSQL, -1, &updateStmt, nullptr);
-    if (rc != SQLITE_OK) {
-        handleSqliteError(db, "prepare statement");
-        return;
+    bool build(sqlite3* db) {
+        const char* selectSQL = "SELECT id, title, author FROM books;";
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(db, selectSQL, -1, &stmt, nullptr) != SQLITE_OK) {
+            return false;
+        }
+
+        arena.clear();
+        records.clear();
+        recordById.clear();
+        deadBytes = 0;
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            const unsigned char* title = sqlite3_column_text(stmt, 1);
+            const unsigned char* author = sqlite3_column_text(stmt, 2);
+            append(sqlite3_column_int(stmt, 0),
+                   title ? reinterpret_cast<const char*>(title) : "",
+                   author ? reinterpret_cast<const char*>(author) : "");
+        }
+        sqlite3_finalize(stmt);
+        if (rc != SQLITE_DONE) {
+            return false;
+        }
+
+        built = true;
+        return true;
     }
 
-    sqlite3_bind_text(updateStmt, 1, newTitle.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(updateStmt, 2, newAuthor.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_int(updateStmt, 3, bookId);
+    void add(int id, const std::string& title, const std::string& author) {
+        remove(id);
+        append(id, title, author);
+    }
 
-    rc = sqlite3_step(updateStmt);
-    if (rc != SQLITE_DONE) {
-        handleSqliteError(db, "execute statement");
-    } else {
-        std::cout << "Book updated successfully.\n";
+    void remove(int id) {
+        auto it = recordById.find(id);
+        if (it == recordById.end()) {
+            return;
+        }
+        Record& record = records[it->second];
+        std::fill_n(arena.begin() + record.offset, record.length, '\0');
+        deadBytes += record.length;
+        record.id = 0;
+        recordById.erase(it);
+        if (deadBytes > arena.size() / 2) {
+            compact();
+        }
     }
 
-    sqlite3_finalize(updateStmt);
+    Book bookAt(const Record& record) const {
+        const char* title = arena.data() + record.offset;
+        return { record.id, title, title + std::strlen(title) + 1 };
+    }
+
+    // Books whose title or author contains the term ignoring ASCII case, like a LIKE '%term%'
+    std::vector<Book> find(const std::string& term) const {
+        static const FindFoldedKernel findFolded = selectFindFoldedKernel();
+
+        std::vector<Book> books;
+        if (term.empty()) {
+            for (const Record& record : records) {
+                if (record.id != 0) {
+                    books.push_back(bookAt(record));
+                }
+            }
+        } else {
+            std::string needle(term.size(), '\0');
+            std::transform(term.begin(), term.end(), needle.begin(), foldCase);
+
+            size_t pos = 0;
+            auto record = records.begin();
+            while ((pos = findFolded(arena.data(), arena.size(), needle, pos))
+                   != std::string::npos) {
+                // Records are visited in arena order, so the search for the owner moves forward
+                record = std::upper_bound(record,
+                                          records.end(),
+                                          pos,
+                                          [](size_t p, const Record& r) { return p < r.offset; })
+                         - 1;
+                books.push_back(bookAt(*record));
+                pos = record->offset + record->length;
+            }
+        }
+        std::sort(books.begin(), books.end(), [](const Book& a, const Book& b) {
+            return a.id < b.id;
+        });
+        return books;
+    }
+};
+
+// Column-oriented in-memory copy of the books table for analytical queries. Authors are
+// dictionary-encoded and titles are stored as (offset, length) pairs into one byte buffer.
+// Rows stay in ascending id order: new books get larger ids and updates are applied in place.
+class ColumnarSnapshot {
+   public:
+    std::vector<int64_t> ids;
+    std::vector<uint32_t> authorCodes;
+    std::vector<uint64_t> titleOffsets;
+    std::vector<uint32_t> titleLengths;
+    std::vector<bool> live;
+    std::string titleBytes;
+    std::vector<std::string> authors;  // dictionary, indexed by author code
+
+   private:
+    std::unordered_map<std::string, uint32_t> authorCodeByName;
+    size_t deadRows = 0;
+    size_t staleTitleBytes = 0;
+    bool built = false;
+
+    uint32_t encodeAuthor(const std::string& author) {
+        auto it = authorCodeByName.find(author);
+        if (it != authorCodeByName.end()) {
+            return it->second;
+        }
+        uint32_t code = static_cast<uint32_t>(authors.size());
+        authors.push_back(author);
+        authorCodeByName.emplace(author, code);
+        return code;
+    }
+
+    void setTitle(size_t row, const std::string& title) {
+        titleOffsets[row] = titleBytes.size();
+        titleLengths[row] = static_cast<uint32_t>(title.size());
+        titleBytes += title;
+    }
+
+    void append(int64_t id, const std::string& title, const std::string& author) {
+        ids.push_back(id);
+        authorCodes.push_back(encodeAuthor(author));
+        titleOffsets.push_back(0);
+        titleLengths.push_back(0);
+        live.push_back(true);
+        setTitle(ids.size() - 1, title);
+    }
+
+    void clear() {
+        ids.clear();
+        authorCodes.clear();
+        titleOffsets.clear();
+        titleLengths.clear();
+        live.clear();
+        titleBytes.clear();
+        authors.clear();
+        authorCodeByName.clear();
+        deadRows = 0;
+        staleTitleBytes = 0;
+    }
+
+    // Rebuild the columns without deleted rows, stale title bytes or unused authors
+    void compact() {
+        ColumnarSnapshot old;
+        std::swap(ids, old.ids);
+        std::swap(authorCodes, old.authorCodes);
+        std::swap(titleOffsets, old.titleOffsets);
+        std::swap(titleLengths, old.titleLengths);
+        std::swap(live, old.live);
+        std::swap(titleBytes, old.titleBytes);
+        std::swap(authors, old.authors);
+        clear();
+        for (size_t row = 0; row < old.ids.size(); row++) {
+            if (old.live[row]) {
+                append(old.ids[row], old.title(row), old.authors[old.authorCodes[row]]);
+            }
+        }
+    }
+
+   public:
+    bool isBuilt() const {
+        return built;
+    }
+
+    bool build(sqlite3* db) {
+        const char* selectSQL = "SELECT id, title, author FROM main.books ORDER BY id;";
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(db, selectSQL, -1, &stmt, nullptr) != SQLITE_OK) {
+            return false;
+        }
+
+        clear();
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            const unsigned char* title = sqlite3_column_text(stmt, 1);
+            const unsigned char* author = sqlite3_column_text(stmt, 2);
+            append(sqlite3_column_int64(stmt, 0),
+                   title ? reinterpret_cast<const char*>(title) : "",
+                   author ? reinterpret_cast<const char*>(author) : "");
+        }
+        sqlite3_finalize(stmt);
+        if (rc != SQLITE_DONE) {
+            clear();
+            return false;
+        }
+
+        built = true;
+        return true;
+    }
+
+    std::string title(size_t row) const {
+        return titleBytes.substr(titleOffsets[row], titleLengths[row]);
+    }
+
+    // Code of an author in the dictionary, or -1 when no book has that author
+    int64_t findAuthor(const std::string& author) const {
+        auto it = authorCodeByName.find(author);
+        return it == authorCodeByName.end() ? -1 : it->second;
+    }
+
+    void add(int64_t id, const std::string& title, const std::string& author) {
+        auto it = std::lower_bound(ids.begin(), ids.end(), id);
+        if (it != ids.end() && *it == id) {
+            // Updates, which remove and re-add the book, reuse its row
+            size_t row = it - ids.begin();
+            if (!live[row]) {
+                live[row] = true;
+                deadRows--;
+            }
+            staleTitleBytes += titleLengths[row];
+            authorCodes[row] = encodeAuthor(author);
+            setTitle(row, title);
+            if (staleTitleBytes > titleBytes.size() / 2) {
+                compact();
+            }
+        } else if (ids.empty() || id > ids.back()) {
+            append(id, title, author);
+        } else {
+            // Only an out-of-order id, e.g. one restored by hand, needs the columns shifted
+            size_t row = it - ids.begin();
+            ids.insert(it, id);
+            authorCodes.insert(authorCodes.begin() + row, encodeAuthor(author));
+            titleOffsets.insert(titleOffsets.begin() + row, 0);
+            titleLengths.insert(titleLengths.begin() + row, 0);
+            live.insert(live.begin() + row, true);
+            setTitle(row, title);
+        }
+    }
+
+    void remove(int64_t id) {
+        auto it = std::lower_bound(ids.begin(), ids.end(), id);
+        if (it == ids.end() || *it != id || !live[it - ids.begin()]) {
+            return;
+        }
+        live[it - ids.begin()] = false;
+        if (++deadRows > ids.size() / 2) {
+            compact();
+        }
+    }
+};
+
+// Global columnar snapshot behind the books_columnar virtual table, built on its first scan
+ColumnarSnapshot columnarBooks;
+
+// Columns of the books_columnar virtual table
+enum ColumnarColumn {
+    COLUMNAR_ID,
+    COLUMNAR_TITLE,
+    COLUMNAR_AUTHOR,
+    COLUMNAR_TITLE_LENGTH,
+    COLUMNAR_AUTHOR_ID
+};
+
+struct ColumnarVtab {
+    sqlite3_vtab base;
+    sqlite3* db;
+};
+
+struct ColumnarCursor {
+    sqlite3_vtab_cursor base;
+    size_t row;
+    size_t end;
+    int64_t authorCode;  // -1 when not filtering by author
+    int64_t minLength;
+    int64_t maxLength;
+};
+
+static int columnarConnect(
+    sqlite3* db, void*, int, const char* const*, sqlite3_vtab** vtab, char**) {
+    int rc = sqlite3_declare_vtab(db,
+                                  "CREATE TABLE x(id INTEGER, title TEXT, author TEXT, "
+                                  "title_length INTEGER, author_id INTEGER)");
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    ColumnarVtab* table = static_cast<ColumnarVtab*>(sqlite3_malloc(sizeof(ColumnarVtab)));
+    if (!table) {
+        return SQLITE_NOMEM;
+    }
+    memset(table, 0, sizeof(ColumnarVtab));
+    table->db = db;
+    *vtab = &table->base;
+    return SQLITE_OK;
+}
+
+static int columnarDisconnect(sqlite3_vtab* vtab) {
+    sqlite3_free(vtab);
+    return SQLITE_OK;
+}
+
+// Push id ranges, author equality and title length ranges down into the scan. The plan is
+// passed to xFilter in idxStr as (column, operator) character pairs in argv order. Filters
+// only ever narrow to a superset of the answer, so SQLite still double-checks each row.
+static int columnarBestIndex(sqlite3_vtab*, sqlite3_index_info* info) {
+    std::string plan;
+    double rows = columnarBooks.isBuilt() ? std::max<double>(columnarBooks.ids.size(), 1) : 1e6;
+    double cost = rows;
+    int argvIndex = 0;
+
+    for (int i = 0; i < info->nConstraint; i++) {
+        const auto& constraint = info->aConstraint[i];
+        if (!constraint.usable) {
+            continue;
+        }
+        char op;
+        switch (constraint.op) {
+        case SQLITE_INDEX_CONSTRAINT_EQ:
+            op = '=';
+            break;
+        case SQLITE_INDEX_CONSTRAINT_GT:
+            op = '>';
+            break;
+        case SQLITE_INDEX_CONSTRAINT_GE:
+            op = 'g';
+            break;
+        case SQLITE_INDEX_CONSTRAINT_LT:
+            op = '<';
+            break;
+        case SQLITE_INDEX_CONSTRAINT_LE:
+            op = 'l';
+            break;
+        default:
+            continue;
+        }
+
+        int column = constraint.iColumn;
+        bool rangeColumn = column == COLUMNAR_ID || column == COLUMNAR_TITLE_LENGTH
+                           || column == COLUMNAR_AUTHOR_ID;
+        bool equalityColumn = column == COLUMNAR_AUTHOR && op == '='
+                              && sqlite3_stricmp(sqlite3_vtab_collation(info, i), "BINARY") == 0;
+        if (!rangeColumn && !equalityColumn) {
+            continue;
+        }
+
+        plan += static_cast<char>('0' + column);
+        plan += op;
+        info->aConstraintUsage[i].argvIndex = ++argvIndex;
+        if (column == COLUMNAR_ID && op == '=') {
+            cost = std::min(cost, std::log2(rows + 1));
+        } else {
+            cost *= op == '=' ? 0.01 : 0.3;
+        }
+    }
+
+    if (info->nOrderBy == 1 && info->aOrderBy[0].iColumn == COLUMNAR_ID
+        && !info->aOrderBy[0].desc) {
+        info->orderByConsumed = 1;
+    }
+
+    info->idxStr = sqlite3_mprintf("%s", plan.c_str());
+    info->needToFreeIdxStr = 1;
+    info->estimatedCost = cost;
+    info->estimatedRows = static_cast<sqlite3_int64>(std::max(cost, 1.0));
+    return SQLITE_OK;
+}
+
+static int columnarOpen(sqlite3_vtab*, sqlite3_vtab_cursor** cursor) {
+    ColumnarCursor* c = static_cast<ColumnarCursor*>(sqlite3_malloc(sizeof(ColumnarCursor)));
+    if (!c) {
+        return SQLITE_NOMEM;
+    }
+    memset(c, 0, sizeof(ColumnarCursor));
+    *cursor = &c->base;
+    return SQLITE_OK;
+}
+
+static int columnarClose(sqlite3_vtab_cursor* cursor) {
+    sqlite3_free(cursor);
+    return SQLITE_OK;
+}
+
+static bool columnarRowMatches(const ColumnarCursor* c, size_t row) {
+    if (!columnarBooks.live[row]) {
+        return false;
+    }
+    if (c->authorCode >= 0 && columnarBooks.authorCodes[row] != c->authorCode) {
+        return false;
+    }
+    int64_t length = columnarBooks.titleLengths[row];
+    return length >= c->minLength && length <= c->maxLength;
+}
+
+static void columnarSkipToMatch(ColumnarCursor* c) {
+    while (c->row < c->end && !columnarRowMatches(c, c->row)) {
+        c->row++;
+    }
+}
+
+static int columnarFilter(
+    sqlite3_vtab_cursor* cursor, int, const char* idxStr, int, sqlite3_value** argv) {
+    ColumnarCursor* c = reinterpret_cast<ColumnarCursor*>(cursor);
+    if (!columnarBooks.isBuilt()) {
+        ColumnarVtab* table = reinterpret_cast<ColumnarVtab*>(cursor->pVtab);
+        if (!columnarBooks.build(table->db)) {
+            return SQLITE_ERROR;
+        }
+    }
+
+    int64_t minId = INT64_MIN, maxId = INT64_MAX;
+    int64_t minAuthor = INT64_MIN, maxAuthor = INT64_MAX;
+    c->authorCode = -1;
+    c->minLength = 0;
+    c->maxLength = INT64_MAX;
+    bool empty = false;
+
+    for (int i = 0; idxStr && idxStr[2 * i]; i++) {
+        int column = idxStr[2 * i] - '0';
+        char op = idxStr[2 * i + 1];
+        sqlite3_value* value = argv[i];
+
+        if (column == COLUMNAR_AUTHOR) {
+            if (sqlite3_value_type(value) == SQLITE_TEXT) {
+                c->authorCode = columnarBooks.findAuthor(
+                    reinterpret_cast<const char*>(sqlite3_value_text(value)));
+                empty |= c->authorCode < 0;
+            }
+            continue;
+        }
+        // Non-integer bounds are left entirely to SQLite's own check
+        if (sqlite3_value_type(value) != SQLITE_INTEGER) {
+            continue;
+        }
+
+        int64_t bound = sqlite3_value_int64(value);
+        int64_t& low = column == COLUMNAR_ID ? minId
+                       : column == COLUMNAR_AUTHOR_ID ? minAuthor
+                                                      : c->minLength;
+        int64_t& high = column == COLUMNAR_ID ? maxId
+                        : column == COLUMNAR_AUTHOR_ID ? maxAuthor
+                                                       : c->maxLength;
+        if ((op == '>' && bound == INT64_MAX) || (op == '<' && bound == INT64_MIN)) {
+            empty = true;
+            continue;
+        }
+        switch (op) {
+        case '=':
+            low = std::max(low, bound);
+            high = std::min(high, bound);
+            break;
+        case '>':
+            low = std::max(low, bound + 1);
+            break;
+        case 'g':
+            low = std::max(low, bound);
+            break;
+        case '<':
+            high = std::min(high, bound - 1);
+            break;
+        case 'l':
+            high = std::min(high, bound);
+            break;
+        }
+    }
+
+    if (minAuthor == maxAuthor && c->authorCode < 0) {
+        c->authorCode = minAuthor;
+    } else if (minAuthor > maxAuthor || (c->authorCode >= 0 && minAuthor == maxAuthor
+                                         && c->authorCode != minAuthor)) {
+        empty = true;
+    }
+
+    // Ids are sorted, so an id range becomes a slice of the columns
+    const auto& ids = columnarBooks.ids;
+    c->row = std::lower_bound(ids.begin(), ids.end(), minId) - ids.begin();
+    c->end = std::upper_bound(ids.begin(), ids.end(), maxId) - ids.begin();
+    if (empty || minId > maxId || c->minLength > c->maxLength) {
+        c->row = c->end;
+    }
+    columnarSkipToMatch(c);
+    return SQLITE_OK;
+}
+
+static int columnarNext(sqlite3_vtab_cursor* cursor) {
+    ColumnarCursor* c = reinterpret_cast<ColumnarCursor*>(cursor);
+    c->row++;
+    columnarSkipToMatch(c);
+    return SQLITE_OK;
+}
+
+static int columnarEof(sqlite3_vtab_cursor* cursor) {
+    const ColumnarCursor* c = reinterpret_cast<const ColumnarCursor*>(cursor);
+    return c->row >= c->end;
+}
+
+static int columnarColumn(sqlite3_vtab_cursor* cursor, sqlite3_context* ctx, int column) {
+    const ColumnarCursor* c = reinterpret_cast<const ColumnarCursor*>(cursor);
+    size_t row = c->row;
+    switch (column) {
+    case COLUMNAR_ID:
+        sqlite3_result_int64(ctx, columnarBooks.ids[row]);
+        break;
+    case COLUMNAR_TITLE:
+        sqlite3_result_text(ctx,
+                            columnarBooks.titleBytes.data() + columnarBooks.titleOffsets[row],
+                            static_cast<int>(columnarBooks.titleLengths[row]),
+                            SQLITE_TRANSIENT);
+        break;
+    case COLUMNAR_AUTHOR: {
+        const std::string& author = columnarBooks.authors[columnarBooks.authorCodes[row]];
+        sqlite3_result_text(ctx, author.data(), static_cast<int>(author.size()), SQLITE_TRANSIENT);
+        break;
+    }
+    case COLUMNAR_TITLE_LENGTH:
+        sqlite3_result_int64(ctx, columnarBooks.titleLengths[row]);
+        break;
+    case COLUMNAR_AUTHOR_ID:
+        sqlite3_result_int64(ctx, columnarBooks.authorCodes[row]);
+        break;
+    }
+    return SQLITE_OK;
+}
+
+static int columnarRowid(sqlite3_vtab_cursor* cursor, sqlite3_int64* rowid) {
+    const ColumnarCursor* c = reinterpret_cast<const ColumnarCursor*>(cursor);
+    *rowid = columnarBooks.ids[c->row];
+    return SQLITE_OK;
+}
+
+// Function to register the columnar module. Its eponymous table books_columnar appears in the
+// main schema without being stored there, so books.db stays readable without the module.
+bool registerColumnarBooks(sqlite3* db) {
+    static sqlite3_module module = [] {
+        sqlite3_module m;
+        memset(&m, 0, sizeof(m));
+        m.xCreate = columnarConnect;
+        m.xConnect = columnarConnect;
+        m.xBestIndex = columnarBestIndex;
+        m.xDisconnect = columnarDisconnect;
+        m.xDestroy = columnarDisconnect;
+        m.xOpen = columnarOpen;
+        m.xClose = columnarClose;
+        m.xFilter = columnarFilter;
+        m.xNext = columnarNext;
+        m.xEof = columnarEof;
+        m.xColumn = columnarColumn;
+        m.xRowid = columnarRowid;
+        return m;
+    }();
+
+    // xCreate is xConnect, so the module is an eponymous table queried by its own name without
+    // a CREATE VIRTUAL TABLE at every start
+    return sqlite3_create_module(db, "books_columnar", &module, nullptr) == SQLITE_OK;
+}
+
+#ifdef BOOKS_HAVE_IO_URING
+// Minimal io_uring driven through the raw system calls, as liburing is not a dependency: the
+// submission and completion rings shared with the kernel, used by one thread at a time
+class IoUring {
+   private:
+    int ringFd = -1;
+    void* sqRing = MAP_FAILED;
+    void* cqRing = MAP_FAILED;
+    size_t sqRingSize = 0;
+    size_t cqRingSize = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqesSize = 0;
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned sqMask = 0;
+    unsigned sqEntries = 0;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+    unsigned queued = 0;  // prepared entries the kernel has not been told about yet
+
+    int enter(unsigned toSubmit, unsigned minComplete) {
+        return static_cast<int>(syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete,
+                                        minComplete > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr,
+                                        0));
+    }
+
+   public:
+    IoUring() = default;
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    ~IoUring() {
+        if (sqes != MAP_FAILED) {
+            munmap(sqes, sqesSize);
+        }
+        if (cqRing != MAP_FAILED && cqRing != sqRing) {
+            munmap(cqRing, cqRingSize);
+        }
+        if (sqRing != MAP_FAILED) {
+            munmap(sqRing, sqRingSize);
+        }
+        if (ringFd >= 0) {
+            close(ringFd);
+        }
+    }
+
+    // Function to set up and map the rings; false when the kernel does not offer io_uring
+    bool init(unsigned entries) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        ringFd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (ringFd < 0) {
+            return false;
+        }
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMap) {
+            sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+        }
+        sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ringFd, IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED) {
+            return false;
+        }
+        cqRing = singleMap ? sqRing
+                           : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE,
+                                  MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED) {
+            return false;
+        }
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+                                               MAP_SHARED | MAP_POPULATE, ringFd,
+                                               IORING_OFF_SQES));
+        if (sqes == MAP_FAILED) {
+            return false;
+        }
+
+        char* sq = static_cast<char*>(sqRing);
+        sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqEntries = params.sq_entries;
+        char* cq = static_cast<char*>(cqRing);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    // Function to prepare a read; false when the submission ring is full
+    bool queueRead(int fd, void* buffer, unsigned length, uint64_t offset, uint64_t tag) {
+        unsigned head = std::atomic_ref<unsigned>(*sqHead).load(std::memory_order_acquire);
+        unsigned tail = *sqTail + queued;
+        if (tail - head >= sqEntries) {
+            return false;
+        }
+        unsigned index = tail & sqMask;
+        io_uring_sqe& sqe = sqes[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_READ;
+        sqe.fd = fd;
+        sqe.addr = reinterpret_cast<uint64_t>(buffer);
+        sqe.len = length;
+        sqe.off = offset;
+        sqe.user_data = tag;
+        sqArray[index] = index;
+        queued++;
+        return true;
+    }
+
+    // Function to hand the prepared reads to the kernel without waiting for them. Returns how
+    // many it accepted, in the order they were prepared; the rest are withdrawn from the ring,
+    // which is safe because the kernel only reads the submission ring inside io_uring_enter.
+    unsigned submit() {
+        unsigned prepared = queued;
+        queued = 0;
+        if (prepared == 0) {
+            return 0;
+        }
+        unsigned tail = *sqTail + prepared;
+        std::atomic_ref<unsigned>(*sqTail).store(tail, std::memory_order_release);
+        unsigned pending = prepared;
+        while (pending > 0) {
+            int submitted = enter(pending, 0);
+            if (submitted < 0 && errno != EINTR) {
+                break;
+            }
+            pending -= std::max(submitted, 0);
+        }
+        if (pending > 0) {
+            std::atomic_ref<unsigned>(*sqTail).store(tail - pending, std::memory_order_release);
+        }
+        return prepared - pending;
+    }
+
+    // Function to take the next completion, waiting for one when none is ready
+    bool complete(uint64_t& tag, int& result) {
+        unsigned head = *cqHead;
+        while (head == std::atomic_ref<unsigned>(*cqTail).load(std::memory_order_acquire)) {
+            if (enter(0, 1) < 0 && errno != EINTR) {
+                return false;
+            }
+        }
+        const io_uring_cqe& cqe = cqes[head & cqMask];
+        tag = cqe.user_data;
+        result = cqe.res;
+        std::atomic_ref<unsigned>(*cqHead).store(head + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+// A run of the file read ahead in URING_WINDOW_BYTES / URING_CHUNK_BYTES parallel reads
+struct UringWindow {
+    std::vector<char> buffer = std::vector<char>(URING_WINDOW_BYTES);
+    sqlite3_int64 start = -1;
+    sqlite3_int64 valid = 0;  // bytes from start that were read, once pending is zero
+    unsigned pending = 0;
+    std::array<int, URING_WINDOW_BYTES / URING_CHUNK_BYTES> results{};
+};
+
+// Read state of a main database file opened through the io_uring VFS. Sequential runs of reads
+// are served from two windows: the one being consumed and the next, already in flight.
+struct UringReader {
+    int fd = -1;  // shared with every other reader of the same inode
+    std::pair<dev_t, ino_t> inode;
+    IoUring ring;
+    UringWindow windows[2];
+    sqlite3_int64 nextSequential = -1;
+    int sequentialReads = 0;
+    int singleResult = 0;
+    bool singlePending = false;
+};
+
+// Read descriptors of the files open through the io_uring VFS, one per inode. Closing any
+// descriptor of a file drops every fcntl lock the process holds on it, the unix VFS's included,
+// so a descriptor stays open until the last file through this VFS on its inode is closed.
+struct UringDescriptor {
+    int fd = -1;
+    int references = 0;
+    std::vector<int> spares;  // opened while the path was being replaced, closed along with fd
+};
+std::mutex uringDescriptorMutex;
+std::map<std::pair<dev_t, ino_t>, UringDescriptor> uringDescriptors;
+
+// Function to share the read descriptor of a file, opening it for the first reader of its inode
+static int acquireUringDescriptor(const char* path, std::pair<dev_t, ino_t>& inode) {
+    std::lock_guard<std::mutex> lock(uringDescriptorMutex);
+    struct stat info;
+    if (stat(path, &info) == 0) {
+        auto found = uringDescriptors.find({info.st_dev, info.st_ino});
+        if (found != uringDescriptors.end()) {
+            found->second.references++;
+            inode = found->first;
+            return found->second.fd;
+        }
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    fstat(fd, &info);
+    inode = {info.st_dev, info.st_ino};
+    UringDescriptor& descriptor = uringDescriptors[inode];
+    if (descriptor.references++ == 0) {
+        descriptor.fd = fd;
+    } else {
+        descriptor.spares.push_back(fd);
+    }
+    return descriptor.fd;
+}
+
+// Function to give up a read descriptor, closing it once no reader of its inode is left
+static void releaseUringDescriptor(const std::pair<dev_t, ino_t>& inode) {
+    std::lock_guard<std::mutex> lock(uringDescriptorMutex);
+    auto found = uringDescriptors.find(inode);
+    if (found == uringDescriptors.end() || --found->second.references > 0) {
+        return;
+    }
+    close(found->second.fd);
+    for (int spare : found->second.spares) {
+        close(spare);
+    }
+    uringDescriptors.erase(found);
+}
+
+// Tags of completions: window reads carry the window and chunk, single reads the bit above
+const uint64_t URING_SINGLE_READ = 1u << 16;
+
+// The file handed to SQLite, followed in memory by the unix VFS's own file
+struct UringFile {
+    sqlite3_file base;
+    sqlite3_file* real;
+    UringReader* reader;  // null for files that are not main databases
+};
+
+// Function to take one completion and record it in the window or single read it belongs to
+static bool uringReap(UringReader* reader) {
+    uint64_t tag;
+    int result;
+    if (!reader->ring.complete(tag, result)) {
+        return false;
+    }
+    if (tag == URING_SINGLE_READ) {
+        reader->singleResult = result;
+        reader->singlePending = false;
+    } else {
+        UringWindow& window = reader->windows[tag >> 8];
+        window.results[tag & 0xFF] = result;
+        window.pending--;
+    }
+    return true;
+}
+
+// Function to wait for a window's reads and work out how many of its bytes are usable
+static bool uringFinishWindow(UringReader* reader, UringWindow& window) {
+    while (window.pending > 0) {
+        if (!uringReap(reader)) {
+            return false;
+        }
+    }
+    window.valid = 0;
+    for (int result : window.results) {
+        window.valid += std::max(result, 0);
+        if (result != static_cast<int>(URING_CHUNK_BYTES)) {
+            break;
+        }
+    }
+    return true;
+}
+
+// Function to check whether a window was started over the given offset
+static bool uringCovers(const UringWindow& window, sqlite3_int64 offset) {
+    return window.start >= 0 && offset >= window.start
+           && offset < window.start + static_cast<sqlite3_int64>(URING_WINDOW_BYTES);
+}
+
+// Function to start reading a window at the given offset. Chunks the ring did not take keep a
+// zero result, so the window simply ends before them.
+static bool uringStartWindow(UringReader* reader, int index, sqlite3_int64 start) {
+    UringWindow& window = reader->windows[index];
+    if (!uringFinishWindow(reader, window)) {
+        return false;
+    }
+    window.start = start;
+    window.valid = 0;
+    window.results.fill(0);
+    for (size_t chunk = 0; chunk < window.results.size(); chunk++) {
+        if (!reader->ring.queueRead(reader->fd, window.buffer.data() + chunk * URING_CHUNK_BYTES,
+                                    URING_CHUNK_BYTES, start + chunk * URING_CHUNK_BYTES,
+                                    (static_cast<uint64_t>(index) << 8) | chunk)) {
+            break;
+        }
+    }
+    window.pending = reader->ring.submit();
+    return true;
+}
+
+// Function to drop the read-ahead data, after waiting out reads still writing into it. Called
+// whenever the lock changes, a WAL lock is taken or released, or this connection writes: other
+// connections may have changed the file in between, and in WAL mode a checkpoint rewrites it
+// while readers keep their SHARED lock.
+static bool uringInvalidate(UringReader* reader) {
+    bool ok = true;
+    for (UringWindow& window : reader->windows) {
+        ok = uringFinishWindow(reader, window) && ok;
+        window.start = -1;
+        window.valid = 0;
+    }
+    reader->sequentialReads = 0;
+    reader->nextSequential = -1;
+    return ok;
+}
+
+static int uringRead(sqlite3_file* file, void* buffer, int amount, sqlite3_int64 offset) {
+    UringFile* f = reinterpret_cast<UringFile*>(file);
+    UringReader* reader = f->reader;
+    if (!reader) {
+        return f->real->pMethods->xRead(f->real, buffer, amount, offset);
+    }
+
+    bool sequential = offset == reader->nextSequential;
+    reader->sequentialReads = sequential ? reader->sequentialReads + 1 : 0;
+    reader->nextSequential = offset + amount;
+    bool readAhead = reader->sequentialReads >= URING_SEQUENTIAL_READS;
+
+    // A long enough run starts both windows at once; afterwards each window that is entered
+    // sends the other one ahead, so the next run is in flight while this one is consumed
+    int hit = uringCovers(reader->windows[0], offset)   ? 0
+              : uringCovers(reader->windows[1], offset) ? 1
+                                                        : -1;
+    if (hit < 0 && readAhead) {
+        if (!uringStartWindow(reader, 0, offset)
+            || !uringStartWindow(reader, 1, offset + URING_WINDOW_BYTES)) {
+            return SQLITE_IOERR_READ;
+        }
+        hit = 0;
+    }
+    if (hit >= 0) {
+        UringWindow& window = reader->windows[hit];
+        if (!uringFinishWindow(reader, window)) {
+            return SQLITE_IOERR_READ;
+        }
+        if (offset + amount <= window.start + window.valid) {
+            std::memcpy(buffer, window.buffer.data() + (offset - window.start), amount);
+            sqlite3_int64 following = window.start + URING_WINDOW_BYTES;
+            if (readAhead && reader->windows[1 - hit].start != following
+                && !uringStartWindow(reader, 1 - hit, following)) {
+                return SQLITE_IOERR_READ;
+            }
+            return SQLITE_OK;
+        }
+    }
+
+    // Anything else is a single read through the ring. Once the kernel has accepted it, the read
+    // has to be waited for, as it writes into SQLite's buffer; before that the plain path is safe.
+    if (!reader->ring.queueRead(reader->fd, buffer, amount, offset, URING_SINGLE_READ)
+        || reader->ring.submit() == 0) {
+        return f->real->pMethods->xRead(f->real, buffer, amount, offset);
+    }
+    reader->singlePending = true;
+    while (reader->singlePending) {
+        if (!uringReap(reader)) {
+            return SQLITE_IOERR_READ;
+        }
+    }
+    if (reader->singleResult < 0) {
+        return SQLITE_IOERR_READ;
+    }
+    if (reader->singleResult < amount) {
+        std::memset(static_cast<char*>(buffer) + reader->singleResult, 0,
+                    amount - reader->singleResult);
+        return SQLITE_IOERR_SHORT_READ;
+    }
+    return SQLITE_OK;
+}
+
+static int uringClose(sqlite3_file* file) {
+    UringFile* f = reinterpret_cast<UringFile*>(file);
+    if (!f->reader) {
+        return f->real->pMethods->xClose(f->real);
+    }
+    uringInvalidate(f->reader);
+    std::pair<dev_t, ino_t> inode = f->reader->inode;
+    delete f->reader;
+    f->reader = nullptr;
+    int rc = f->real->pMethods->xClose(f->real);
+    releaseUringDescriptor(inode);
+    return rc;
+}
+
+// Function to return the file of the unix VFS that an io_uring file wraps
+static sqlite3_file* uringReal(sqlite3_file* file) {
+    return reinterpret_cast<UringFile*>(file)->real;
+}
+
+// Function to drop the read-ahead data of a file before its contents or lock change
+static bool uringForget(sqlite3_file* file) {
+    UringReader* reader = reinterpret_cast<UringFile*>(file)->reader;
+    return !reader || uringInvalidate(reader);
+}
+
+static const sqlite3_io_methods uringMethods = {
+    3,
+    uringClose,
+    uringRead,
+    [](sqlite3_file* file, const void* data, int amount, sqlite3_int64 offset) {
+        uringForget(file);
+        return uringReal(file)->pMethods->xWrite(uringReal(file), data, amount, offset);
+    },
+    [](sqlite3_file* file, sqlite3_int64 size) {
+        uringForget(file);
+        return uringReal(file)->pMethods->xTruncate(uringReal(file), size);
+    },
+    [](sqlite3_file* file, int flags) {
+        return uringReal(file)->pMethods->xSync(uringReal(file), flags);
+    },
+    [](sqlite3_file* file, sqlite3_int64* size) {
+        return uringReal(file)->pMethods->xFileSize(uringReal(file), size);
+    },
+    [](sqlite3_file* file, int lock) {
+        uringForget(file);
+        return uringReal(file)->pMethods->xLock(uringReal(file), lock);
+    },
+    [](sqlite3_file* file, int lock) {
+        uringForget(file);
+        return uringReal(file)->pMethods->xUnlock(uringReal(file), lock);
+    },
+    [](sqlite3_file* file, int* reserved) {
+        return uringReal(file)->pMethods->xCheckReservedLock(uringReal(file), reserved);
+    },
+    [](sqlite3_file* file, int op, void* argument) {
+        return uringReal(file)->pMethods->xFileControl(uringReal(file), op, argument);
+    },
+    [](sqlite3_file* file) { return uringReal(file)->pMethods->xSectorSize(uringReal(file)); },
+    [](sqlite3_file* file) {
+        return uringReal(file)->pMethods->xDeviceCharacteristics(uringReal(file));
+    },
+    [](sqlite3_file* file, int page, int size, int extend, void volatile** memory) {
+        return uringReal(file)->pMethods->xShmMap(uringReal(file), page, size, extend, memory);
+    },
+    [](sqlite3_file* file, int offset, int count, int flags) {
+        uringForget(file);
+        return uringReal(file)->pMethods->xShmLock(uringReal(file), offset, count, flags);
+    },
+    [](sqlite3_file* file) { uringReal(file)->pMethods->xShmBarrier(uringReal(file)); },
+    [](sqlite3_file* file, int deleteFlag) {
+        return uringReal(file)->pMethods->xShmUnmap(uringReal(file), deleteFlag);
+    },
+    [](sqlite3_file* file, sqlite3_int64 offset, int amount, void** page) {
+        return uringReal(file)->pMethods->xFetch(uringReal(file), offset, amount, page);
+    },
+    [](sqlite3_file* file, sqlite3_int64 offset, void* page) {
+        return uringReal(file)->pMethods->xUnfetch(uringReal(file), offset, page);
+    },
+};
+
+// Function to return the unix VFS that the io_uring VFS wraps
+static sqlite3_vfs* uringBase(sqlite3_vfs* vfs) {
+    return static_cast<sqlite3_vfs*>(vfs->pAppData);
+}
+
+static int uringOpen(sqlite3_vfs* vfs, const char* name, sqlite3_file* file, int flags,
+                     int* outFlags) {
+    UringFile* f = reinterpret_cast<UringFile*>(file);
+    f->base.pMethods = nullptr;
+    f->real = reinterpret_cast<sqlite3_file*>(f + 1);
+    f->reader = nullptr;
+    int rc = uringBase(vfs)->xOpen(uringBase(vfs), name, f->real, flags, outFlags);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+    f->base.pMethods = &uringMethods;
+
+    // Only main databases are read in bulk; journals and temp files stay on the plain path.
+    // Reads use a descriptor of their own, as the unix VFS does not expose its descriptor.
+    if ((flags & SQLITE_OPEN_MAIN_DB) && name) {
+        auto reader = std::make_unique<UringReader>();
+        if (reader->ring.init(URING_QUEUE_DEPTH)) {
+            reader->fd = acquireUringDescriptor(name, reader->inode);
+            if (reader->fd >= 0) {
+                f->reader = reader.release();
+            }
+        }
+    }
+    return SQLITE_OK;
+}
+#endif
+
+// Function to register the "uring" VFS, which reads main database files through io_uring with
+// read-ahead of sequential runs and leaves writes, locking and every other file to the default
+// VFS. makeDefault routes every connection opened afterwards through it.
+bool registerUringVfs(bool makeDefault) {
+#ifdef BOOKS_HAVE_IO_URING
+    static sqlite3_vfs vfs;
+    if (sqlite3_vfs_find(URING_VFS_NAME)) {
+        return sqlite3_vfs_register(sqlite3_vfs_find(URING_VFS_NAME), makeDefault) == SQLITE_OK;
+    }
+
+    // Check once that this kernel lets us set up a ring at all
+    IoUring probe;
+    sqlite3_vfs* base = sqlite3_vfs_find(nullptr);
+    if (!base || !probe.init(1)) {
+        std::cerr << "io_uring is not available; keeping the default VFS.\n";
+        return false;
+    }
+
+    vfs.iVersion = 2;
+    vfs.szOsFile = static_cast<int>(sizeof(UringFile)) + base->szOsFile;
+    vfs.mxPathname = base->mxPathname;
+    vfs.zName = URING_VFS_NAME;
+    vfs.pAppData = base;
+    vfs.xOpen = uringOpen;
+    vfs.xDelete = [](sqlite3_vfs* v, const char* name, int syncDir) {
+        return uringBase(v)->xDelete(uringBase(v), name, syncDir);
+    };
+    vfs.xAccess = [](sqlite3_vfs* v, const char* name, int flags, int* result) {
+        return uringBase(v)->xAccess(uringBase(v), name, flags, result);
+    };
+    vfs.xFullPathname = [](sqlite3_vfs* v, const char* name, int size, char* out) {
+        return uringBase(v)->xFullPathname(uringBase(v), name, size, out);
+    };
+    vfs.xDlOpen = [](sqlite3_vfs* v, const char* name) {
+        return uringBase(v)->xDlOpen(uringBase(v), name);
+    };
+    vfs.xDlError = [](sqlite3_vfs* v, int size, char* message) {
+        uringBase(v)->xDlError(uringBase(v), size, message);
+    };
+    vfs.xDlSym = [](sqlite3_vfs* v, void* handle, const char* symbol) {
+        return uringBase(v)->xDlSym(uringBase(v), handle, symbol);
+    };
+    vfs.xDlClose = [](sqlite3_vfs* v, void* handle) {
+        uringBase(v)->xDlClose(uringBase(v), handle);
+    };
+    vfs.xRandomness = [](sqlite3_vfs* v, int size, char* out) {
+        return uringBase(v)->xRandomness(uringBase(v), size, out);
+    };
+    vfs.xSleep = [](sqlite3_vfs* v, int microseconds) {
+        return uringBase(v)->xSleep(uringBase(v), microseconds);
+    };
+    vfs.xCurrentTime = [](sqlite3_vfs* v, double* now) {
+        return uringBase(v)->xCurrentTime(uringBase(v), now);
+    };
+    vfs.xGetLastError = [](sqlite3_vfs* v, int size, char* message) {
+        return uringBase(v)->xGetLastError(uringBase(v), size, message);
+    };
+    vfs.xCurrentTimeInt64 = [](sqlite3_vfs* v, sqlite3_int64* now) {
+        return uringBase(v)->xCurrentTimeInt64(uringBase(v), now);
+    };
+    return sqlite3_vfs_register(&vfs, makeDefault) == SQLITE_OK;
+#else
+    (void)makeDefault;
+    std::cerr << "This build has no io_uring support; keeping the default VFS.\n";
+    return false;
+#endif
+}
+
+// Blocked Bloom filter over titles so addBook can skip the UNIQUE index probe for titles that
+// are certainly new. Every title sets BLOOM_HASHES bits inside one 512-bit block, so a lookup
+// touches a single cache line. Deleted titles cannot be cleared and only add false positives.
+class TitleBloomFilter {
+   private:
+    static const int BLOOM_HASHES = 7;
+    static const size_t BLOOM_BITS_PER_TITLE = 12;
+
+    std::vector<std::array<uint64_t, 8>> blocks;
+    size_t titles = 0;
+    size_t capacity = 0;
+    uint64_t lookups = 0;
+    uint64_t maybeResults = 0;
+    uint64_t falsePositives = 0;
+    bool built = false;
+
+    static uint64_t mix(uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    // The first hash picks the block, nine-bit slices of the second pick the bits in it
+    static std::pair<uint64_t, uint64_t> hash(const std::string& title) {
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for (unsigned char c : title) {
+            h = (h ^ c) * 0x100000001b3ULL;
+        }
+        uint64_t first = mix(h);
+        return { first, mix(first ^ 0x9e3779b97f4a7c15ULL) };
+    }
+
+    void insert(const std::string& title) {
+        auto h = hash(title);
+        std::array<uint64_t, 8>& block = blocks[h.first % blocks.size()];
+        for (int i = 0; i < BLOOM_HASHES; i++) {
+            unsigned bit = (h.second >> (9 * i)) & 511;
+            block[bit / 64] |= uint64_t(1) << (bit % 64);
+        }
+        titles++;
+    }
+
+   public:
+    bool isBuilt() const {
+        return built;
+    }
+
+    // The filter is rebuilt at twice the size once more titles than planned were added
+    bool isFull() const {
+        return titles > capacity;
+    }
+
+    bool build(sqlite3* db) {
+        sqlite3_stmt* stmt;
+        const char* countSQL = "SELECT COUNT(*) FROM books;";
+        if (sqlite3_prepare_v2(db, countSQL, -1, &stmt, nullptr) != SQLITE_OK) {
+            return false;
+        }
+        size_t existing = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int64(stmt, 0) : 0;
+        sqlite3_finalize(stmt);
+
+        const char* selectSQL = "SELECT title FROM books;";
+        if (sqlite3_prepare_v2(db, selectSQL, -1, &stmt, nullptr) != SQLITE_OK) {
+            return false;
+        }
+        capacity = std::max<size_t>(2 * existing, 1024);
+        blocks.assign((capacity * BLOOM_BITS_PER_TITLE + 511) / 512, {});
+        titles = 0;
+
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            const unsigned char* title = sqlite3_column_text(stmt, 0);
+            insert(title ? reinterpret_cast<const char*>(title) : "");
+        }
+        sqlite3_finalize(stmt);
+        built = rc == SQLITE_DONE;
+        return built;
+    }
+
+    void add(const std::string& title) {
+        insert(title);
+    }
+
+    bool mayContain(const std::string& title) {
+        lookups++;
+        auto h = hash(title);
+        const std::array<uint64_t, 8>& block = blocks[h.first % blocks.size()];
+        for (int i = 0; i < BLOOM_HASHES; i++) {
+            unsigned bit = (h.second >> (9 * i)) & 511;
+            if (!(block[bit / 64] & (uint64_t(1) << (bit % 64)))) {
+                return false;
+            }
+        }
+        maybeResults++;
+        return true;
+    }
+
+    // Called when the index probe shows a "maybe" from the filter was wrong
+    void recordFalsePositive() {
+        falsePositives++;
+    }
+
+    uint64_t lookupCount() const {
+        return lookups;
+    }
+
+    uint64_t probesSkipped() const {
+        return lookups - maybeResults;
+    }
+
+    // Share of probed titles that turned out to be new
+    double observedFalsePositiveRate() const {
+        uint64_t negatives = falsePositives + probesSkipped();
+        return negatives ? static_cast<double>(falsePositives) / negatives : 0.0;
+    }
+
+    // Textbook rate for the current fill, (1 - e^(-kn/m))^k
+    double estimatedFalsePositiveRate() const {
+        if (blocks.empty()) {
+            return 0.0;
+        }
+        double bits = static_cast<double>(blocks.size()) * 512;
+        return std::pow(1 - std::exp(-BLOOM_HASHES * static_cast<double>(titles) / bits),
+                        BLOOM_HASHES);
+    }
+};
+
+// Global in-memory search indexes, each built on its first use
+FuzzyIndex fuzzyIndex;
+PrefixIndex prefixIndex;
+TextSnapshot textSnapshot;
+TitleBloomFilter titleFilter;
+
+// Functions to keep the in-memory search indexes in sync with the books table
+void indexBook(int id, const std::string& title, const std::string& author) {
+    if (titleFilter.isBuilt()) {
+        titleFilter.add(title);
+    }
+    if (fuzzyIndex.isBuilt()) {
+        fuzzyIndex.add(id, title, author);
+    }
+    if (prefixIndex.isBuilt()) {
+        prefixIndex.add(title, author);
+    }
+    if (textSnapshot.isBuilt()) {
+        textSnapshot.add(id, title, author);
+    }
+    if (columnarBooks.isBuilt()) {
+        columnarBooks.add(id, title, author);
+    }
+}
+
+void unindexBook(int id, const std::string& title, const std::string& author) {
+    if (fuzzyIndex.isBuilt()) {
+        fuzzyIndex.remove(id);
+    }
+    if (prefixIndex.isBuilt()) {
+        prefixIndex.remove(title, author);
+    }
+    if (textSnapshot.isBuilt()) {
+        textSnapshot.remove(id);
+    }
+    if (columnarBooks.isBuilt()) {
+        columnarBooks.remove(id);
+    }
+}
+
+// Append-only log of length-framed records, each laid out in host byte order as
+//   uint32 length | uint64 sequence | body | uint32 length
+// after a magic header. The trailing length lets a reopened log find its last sequence number
+// from the end of the file, and lets readers tell a complete record from a half-written one.
+class FramedLog {
+   private:
+    std::ofstream out;
+    uint64_t nextSequence = 1;
+
+   public:
+    bool isOpen() const {
+        return out.is_open();
+    }
+
+    bool open(const std::string& path, const std::string& magic) {
+        std::ifstream existing(path, std::ios::binary | std::ios::ate);
+        bool fresh = !existing || existing.tellg() == 0;
+        if (existing && existing.tellg() > static_cast<std::streamoff>(magic.size())) {
+            uint32_t length = 0;
+            uint64_t sequence = 0;
+            existing.seekg(-static_cast<std::streamoff>(sizeof(length)), std::ios::end);
+            existing.read(reinterpret_cast<char*>(&length), sizeof(length));
+            existing.seekg(-static_cast<std::streamoff>(length + sizeof(length)), std::ios::cur);
+            existing.read(reinterpret_cast<char*>(&sequence), sizeof(sequence));
+            if (!existing) {
+                std::cerr << "Log " << path << " ends with a damaged record.\n";
+                return false;
+            }
+            nextSequence = sequence + 1;
+        }
+        existing.close();
+
+        out.open(path, std::ios::binary | std::ios::app);
+        if (!out) {
+            std::cerr << "Can't open log " << path << "\n";
+            return false;
+        }
+        if (fresh) {
+            out << magic;
+            out.flush();
+        }
+        return true;
+    }
+
+    // Function to append a record, returning its sequence number
+    uint64_t append(const std::string& body) {
+        uint64_t sequence = nextSequence++;
+        uint32_t length = static_cast<uint32_t>(sizeof(sequence) + body.size());
+        out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        out.write(reinterpret_cast<const char*>(&sequence), sizeof(sequence));
+        out << body;
+        out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        return sequence;
+    }
+
+    void flush() {
+        out.flush();
+    }
+};
+
+// Sequential reader for a FramedLog that can keep polling a log another process appends to
+class FramedLogReader {
+   private:
+    std::ifstream in;
+
+   public:
+    bool open(const std::string& path, const std::string& magic) {
+        in.open(path, std::ios::binary);
+        std::string header(magic.size(), '\0');
+        return in.read(&header[0], header.size()) && header == magic;
+    }
+
+    // Function to read the next complete record. At the end of the log, or at a record the
+    // writer has not finished, it returns false and the next call retries the same record.
+    bool next(uint64_t& sequence, std::string& body) {
+        std::streampos start = in.tellg();
+        uint32_t length = 0, trailer = 0;
+        if (in.read(reinterpret_cast<char*>(&length), sizeof(length))
+            && length >= sizeof(sequence)) {
+            in.read(reinterpret_cast<char*>(&sequence), sizeof(sequence));
+            body.resize(length - sizeof(sequence));
+            in.read(&body[0], body.size());
+            in.read(reinterpret_cast<char*>(&trailer), sizeof(trailer));
+        }
+        if (!in || trailer != length) {
+            in.clear();
+            in.seekg(start);
+            return false;
+        }
+        return true;
+    }
+};
+
+// Change data capture for the books table. sqlite3_update_hook only notes which rows changed,
+// because the hook may not use the connection; flush() then reads the new values once the
+// writing statement has finished and appends them to the change log. Each record body is
+//   int64 rowid | uint8 op ('I', 'U' or 'D') | uint32 title length | title
+//   | uint32 author length | author
+class ChangeCapture {
+   private:
+    struct PendingChange {
+        char op;
+        sqlite3_int64 rowid;
+    };
+
+    std::vector<PendingChange> pending;
+    FramedLog log;
+
+    static void onUpdate(void* self,
+                         int op,
+                         const char* database,
+                         const char* table,
+                         sqlite3_int64 rowid) {
+        if (std::strcmp(database, "main") != 0 || std::strcmp(table, "books") != 0) {
+            return;
+        }
+        char code = op == SQLITE_INSERT ? 'I' : (op == SQLITE_UPDATE ? 'U' : 'D');
+        static_cast<ChangeCapture*>(self)->pending.push_back({ code, rowid });
+    }
+
+    template <typename T>
+    static void put(std::string& out, T value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+   public:
+    // Function to start capturing changes into the log, continuing its sequence numbers
+    bool open(sqlite3* db, const std::string& path) {
+        if (!log.open(path, CHANGE_LOG_MAGIC)) {
+            return false;
+        }
+        sqlite3_update_hook(db, onUpdate, this);
+        // Rows noted by a transaction that is rolled back never happened
+        sqlite3_rollback_hook(
+            db, [](void* self) { static_cast<ChangeCapture*>(self)->pending.clear(); }, this);
+        return true;
+    }
+
+    // Function to append the changes noted since the last flush to the log
+    void flush(sqlite3* db) {
+        if (pending.empty()) {
+            return;
+        }
+
+        const char* selectSQL = "SELECT title, author FROM books WHERE rowid = ?;";
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(db, selectSQL, -1, &stmt, nullptr) != SQLITE_OK) {
+            handleSqliteError(db, "prepare statement");
+            pending.clear();
+            return;
+        }
+
+        std::string record;
+        for (const PendingChange& change : pending) {
+            std::string title, author;
+            if (change.op != 'D') {
+                sqlite3_bind_int64(stmt, 1, change.rowid);
+                if (sqlite3_step(stmt) == SQLITE_ROW) {
+                    const unsigned char* t = sqlite3_column_text(stmt, 0);
+                    const unsigned char* a = sqlite3_column_text(stmt, 1);
+                    title = t ? reinterpret_cast<const char*>(t) : "";
+                    author = a ? reinterpret_cast<const char*>(a) : "";
+                }
+                sqlite3_reset(stmt);
+            }
+
+            record.clear();
+            put<int64_t>(record, change.rowid);
+            put<char>(record, change.op);
+            put<uint32_t>(record, static_cast<uint32_t>(title.size()));
+            record += title;
+            put<uint32_t>(record, static_cast<uint32_t>(author.size()));
+            record += author;
+            log.append(record);
+        }
+        sqlite3_finalize(stmt);
+        pending.clear();
+        log.flush();
+    }
+};
+
+#ifdef SQLITE_ENABLE_SESSION
+// Leader side of follower replication. A session on the books table collects the changes of
+// each write transaction, and publish() appends them to the changeset log as one record that
+// "main replicate" later applies to the follower.
+class ChangesetPublisher {
+   private:
+    sqlite3* db = nullptr;
+    sqlite3_session* session = nullptr;
+    FramedLog log;
+
+    bool startSession() {
+        if (sqlite3session_create(db, "main", &session) != SQLITE_OK) {
+            return false;
+        }
+        return sqlite3session_attach(session, "books") == SQLITE_OK;
+    }
+
+   public:
+    ~ChangesetPublisher() {
+        if (session) {
+            sqlite3session_delete(session);
+        }
+    }
+
+    bool open(sqlite3* leader, const std::string& path) {
+        db = leader;
+        return log.open(path, CHANGESET_LOG_MAGIC) && startSession();
+    }
+
+    // Function to publish the changes made since the last call. Sessions only accumulate,
+    // so each changeset is taken from a fresh one.
+    void publish() {
+        if (!session || sqlite3session_isempty(session)) {
+            return;
+        }
+        int size = 0;
+        void* changeset = nullptr;
+        if (sqlite3session_changeset(session, &size, &changeset) == SQLITE_OK && size > 0) {
+            log.append(std::string(static_cast<const char*>(changeset), size));
+            log.flush();
+        }
+        sqlite3_free(changeset);
+        sqlite3session_delete(session);
+        session = nullptr;
+        if (!startSession()) {
+            handleSqliteError(db, "restart replication session");
+        }
+    }
+};
+
+// Global replication publisher, enabled with --publish-changesets
+ChangesetPublisher changesetPublisher;
+#endif
+
+// Global change capture, enabled with --capture-changes
+ChangeCapture changeCapture;
+
+// Function to hand the changes of a finished write to the change log and the replication log
+void publishChanges(sqlite3* db) {
+    changeCapture.flush(db);
+#ifdef SQLITE_ENABLE_SESSION
+    changesetPublisher.publish();
+#endif
+}
+
+// Catalog partitioned by a hash of the title across several database files, each with the same
+// books table. Ids stay globally unique because shard s only hands out ids congruent to s
+// modulo the shard count, above anything its AUTOINCREMENT sequence has seen. A book keeps
+// its id for life; a rename that changes the title's shard moves the row in one transaction
+// over both files, so every title always lives in its hash shard and its UNIQUE index
+// still rejects duplicates.
+class ShardedCatalog {
+   private:
+    std::vector<std::string> paths;
+    std::vector<sqlite3*> shards;
+
+    static uint64_t titleHash(const std::string& title) {
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for (unsigned char c : title) {
+            h = (h ^ c) * 0x100000001b3ULL;
+        }
+        return h;
+    }
+
+    bool exec(sqlite3* db, const std::string& sql) {
+        if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK) {
+            handleSqliteError(db, "shard statement");
+            return false;
+        }
+        return true;
+    }
+
+    // Next id for a shard: the smallest value congruent to the shard above its sequence
+    bool nextId(size_t shard, sqlite3_int64& id) {
+        sqlite3_stmt* stmt;
+        const char* sequenceSQL
+            = "SELECT COALESCE((SELECT seq FROM sqlite_sequence WHERE name = 'books'), 0);";
+        if (sqlite3_prepare_v2(shards[shard], sequenceSQL, -1, &stmt, nullptr) != SQLITE_OK) {
+            handleSqliteError(shards[shard], "prepare statement");
+            return false;
+        }
+        sqlite3_int64 sequence =
+            sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int64(stmt, 0) : 0;
+        sqlite3_finalize(stmt);
+
+        sqlite3_int64 count = static_cast<sqlite3_int64>(shards.size());
+        id = sequence - sequence % count + static_cast<sqlite3_int64>(shard);
+        if (id <= sequence) {
+            id += count;
+        }
+        return true;
+    }
+
+   public:
+    ~ShardedCatalog() {
+        for (sqlite3* shard : shards) {
+            sqlite3_close(shard);
+        }
+    }
+
+    size_t size() const {
+        return shards.size();
+    }
+
+    size_t shardFor(const std::string& title) const {
+        return titleHash(title) % shards.size();
+    }
+
+    // Function to open or create the shard files, refusing ones made for another shard count
+    bool open(size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            paths.push_back("books.shard" + std::to_string(i) + ".db");
+            sqlite3* db;
+            if (sqlite3_open(paths.back().c_str(), &db) != SQLITE_OK) {
+                handleSqliteError(db, "open shard");
+                sqlite3_close(db);
+                return false;
+            }
+            shards.push_back(db);
+
+            if (!exec(db,
+                      "CREATE TABLE IF NOT EXISTS books (id INTEGER PRIMARY KEY AUTOINCREMENT, "
+                      "title TEXT UNIQUE, author TEXT);"
+                      "CREATE TABLE IF NOT EXISTS shard_info "
+                      "(shard INTEGER, shard_count INTEGER);")) {
+                return false;
+            }
+            sqlite3_stmt* stmt;
+            if (sqlite3_prepare_v2(db, "SELECT shard, shard_count FROM shard_info;", -1, &stmt,
+                                   nullptr) != SQLITE_OK) {
+                handleSqliteError(db, "prepare statement");
+                return false;
+            }
+            bool known = sqlite3_step(stmt) == SQLITE_ROW;
+            bool matches = known && sqlite3_column_int64(stmt, 0) == static_cast<sqlite3_int64>(i)
+                           && sqlite3_column_int64(stmt, 1) == static_cast<sqlite3_int64>(count);
+            sqlite3_finalize(stmt);
+            if (known && !matches) {
+                std::cerr << paths.back()
+                          << " belongs to a catalog with a different shard count.\n";
+                return false;
+            }
+            if (!known
+                && !exec(db,
+                         "INSERT INTO shard_info VALUES (" + std::to_string(i) + ", "
+                             + std::to_string(count) + ");")) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Function to find the shard holding a book, or -1 when no shard has it
+    int locate(sqlite3_int64 id, Book* book) {
+        // Most books never move, so the shard that issued the id is tried first
+        size_t count = shards.size();
+        size_t home = static_cast<size_t>(id % static_cast<sqlite3_int64>(count));
+        for (size_t n = 0; n < count; n++) {
+            size_t shard = (home + n) % count;
+            sqlite3_stmt* stmt;
+            const char* selectSQL = "SELECT title, author FROM books WHERE id = ?;";
+            if (sqlite3_prepare_v2(shards[shard], selectSQL, -1, &stmt, nullptr) != SQLITE_OK) {
+                continue;
+            }
+            sqlite3_bind_int64(stmt, 1, id);
+            bool found = sqlite3_step(stmt) == SQLITE_ROW;
+            if (found && book) {
+                book->id = static_cast<int>(id);
+                book->title = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+                book->author = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+            }
+            sqlite3_finalize(stmt);
+            if (found) {
+                return static_cast<int>(shard);
+            }
+        }
+        return -1;
+    }
+
+    // Function to add a book to its title's shard, returning its id or 0 on failure
+    sqlite3_int64 addBook(const std::string& title, const std::string& author) {
+        size_t shard = shardFor(title);
+        sqlite3* db = shards[shard];
+        sqlite3_int64 id;
+        if (!exec(db, "BEGIN IMMEDIATE;")) {
+            return 0;
+        }
+        if (!nextId(shard, id)) {
+            exec(db, "ROLLBACK;");
+            return 0;
+        }
+
+        sqlite3_stmt* stmt;
+        const char* insertSQL = "INSERT INTO books (id, title, author) VALUES (?, ?, ?);";
+        if (sqlite3_prepare_v2(db, insertSQL, -1, &stmt, nullptr) != SQLITE_OK) {
+            handleSqliteError(db, "prepare statement");
+            exec(db, "ROLLBACK;");
+            return 0;
+        }
+        sqlite3_bind_int64(stmt, 1, id);
+        sqlite3_bind_text(stmt, 2, title.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 3, author.c_str(), -1, SQLITE_STATIC);
+        int rc = sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
+        if (rc != SQLITE_DONE) {
+            handleSqliteError(db, "execute statement");
+            exec(db, "ROLLBACK;");
+            return 0;
+        }
+        return exec(db, "COMMIT;") ? id : 0;
+    }
+
+    // Function to change a book, moving it when its new title hashes to another shard
+    bool updateBook(sqlite3_int64 id, const std::string& title, const std::string& author) {
+        int current = locate(id, nullptr);
+        if (current < 0) {
+            return false;
+        }
+        size_t target = shardFor(title);
+        sqlite3* db = shards[current];
+
+        if (static_cast<size_t>(current) == target) {
+            sqlite3_stmt* stmt;
+            const char* updateSQL = "UPDATE books SET title = ?, author = ? WHERE id = ?;";
+            if (sqlite3_prepare_v2(db, updateSQL, -1, &stmt, nullptr) != SQLITE_OK) {
+                handleSqliteError(db, "prepare statement");
+                return false;
+            }
+            sqlite3_bind_text(stmt, 1, title.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(stmt, 2, author.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_int64(stmt, 3, id);
+            int rc = sqlite3_step(stmt);
+            sqlite3_finalize(stmt);
+            if (rc != SQLITE_DONE) {
+                handleSqliteError(db, "execute statement");
+            }
+            return rc == SQLITE_DONE;
+        }
+
+        // ATTACH makes the move a single transaction across both shard files
+        char* attachSQL = sqlite3_mprintf("ATTACH %Q AS target;", paths[target].c_str());
+        bool attached = exec(db, attachSQL);
+        sqlite3_free(attachSQL);
+        if (!attached) {
+            return false;
+        }
+        bool ok = exec(db, "BEGIN IMMEDIATE;");
+        if (ok) {
+            sqlite3_stmt* stmt;
+            const char* moveSQL = "INSERT INTO target.books (id, title, author) VALUES (?, ?, ?);";
+            if (sqlite3_prepare_v2(db, moveSQL, -1, &stmt, nullptr) != SQLITE_OK) {
+                handleSqliteError(db, "prepare statement");
+                ok = false;
+            } else {
+                sqlite3_bind_int64(stmt, 1, id);
+                sqlite3_bind_text(stmt, 2, title.c_str(), -1, SQLITE_STATIC);
+                sqlite3_bind_text(stmt, 3, author.c_str(), -1, SQLITE_STATIC);
+                ok = sqlite3_step(stmt) == SQLITE_DONE;
+                sqlite3_finalize(stmt);
+                if (!ok) {
+                    handleSqliteError(db, "execute statement");
+                }
+            }
+        }
+        ok = ok && exec(db, "DELETE FROM main.books WHERE id = " + std::to_string(id) + ";");
+        exec(db, ok ? "COMMIT;" : "ROLLBACK;");
+        exec(db, "DETACH target;");
+        return ok;
+    }
+
+    bool deleteBook(sqlite3_int64 id) {
+        int shard = locate(id, nullptr);
+        return shard >= 0
+               && exec(shards[shard], "DELETE FROM books WHERE id = " + std::to_string(id) + ";");
+    }
+
+    // Function to run one query on every shard and merge the rows, each shard's result being
+    // sorted on (key column, id), or on id alone when the key column is 0. Rows are streamed to
+    // the visitor through a k-way merge, so nothing is held beyond one row per shard.
+    bool mergeQuery(const std::string& sql,
+                    const std::vector<std::string>& parameters,
+                    int keyColumn,
+                    bool descending,
+                    const std::function<void(const Book&)>& visit) {
+        struct Cursor {
+            sqlite3_stmt* stmt;
+            std::string key;
+            sqlite3_int64 id;
+        };
+        std::vector<Cursor> cursors;
+        auto advance = [&](Cursor& cursor) {
+            if (sqlite3_step(cursor.stmt) != SQLITE_ROW) {
+                return false;
+            }
+            cursor.id = sqlite3_column_int64(cursor.stmt, 0);
+            if (keyColumn > 0) {
+                const unsigned char* key = sqlite3_column_text(cursor.stmt, keyColumn);
+                cursor.key = key ? reinterpret_cast<const char*>(key) : "";
+            }
+            return true;
+        };
+        // Heap order: the cursor whose row comes next sits on top
+        auto later = [descending](const Cursor* a, const Cursor* b) {
+            if (a->key != b->key) {
+                return descending ? a->key < b->key : a->key > b->key;
+            }
+            return descending ? a->id < b->id : a->id > b->id;
+        };
+
+        cursors.reserve(shards.size());
+        for (sqlite3* db : shards) {
+            sqlite3_stmt* stmt;
+            if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+                handleSqliteError(db, "prepare statement");
+                for (Cursor& cursor : cursors) {
+                    sqlite3_finalize(cursor.stmt);
+                }
+                return false;
+            }
+            for (size_t i = 0; i < parameters.size(); i++) {
+                sqlite3_bind_text(stmt, static_cast<int>(i + 1), parameters[i].c_str(), -1,
+                                  SQLITE_STATIC);
+            }
+            cursors.push_back({ stmt, "", 0 });
+        }
+
+        std::vector<Cursor*> heap;
+        for (Cursor& cursor : cursors) {
+            if (advance(cursor)) {
+                heap.push_back(&cursor);
+            }
+        }
+        std::make_heap(heap.begin(), heap.end(), later);
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), later);
+            Cursor* next = heap.back();
+            const unsigned char* title = sqlite3_column_text(next->stmt, 1);
+            const unsigned char* author = sqlite3_column_text(next->stmt, 2);
+            visit({ static_cast<int>(next->id),
+                    title ? reinterpret_cast<const char*>(title) : "",
+                    author ? reinterpret_cast<const char*>(author) : "" });
+            if (advance(*next)) {
+                std::push_heap(heap.begin(), heap.end(), later);
+            } else {
+                heap.pop_back();
+            }
+        }
+
+        for (Cursor& cursor : cursors) {
+            sqlite3_finalize(cursor.stmt);
+        }
+        return true;
+    }
+
+    bool searchBooks(const std::string& term, const std::function<void(const Book&)>& visit) {
+        std::string pattern = "%" + term + "%";
+        return mergeQuery("SELECT id, title, author FROM books "
+                          "WHERE title LIKE ?1 OR author LIKE ?1 ORDER BY id;",
+                          { pattern },
+                          0,
+                          false,
+                          visit);
+    }
+
+    bool viewBooks(const std::string& orderBy,
+                   bool descending,
+                   const std::function<void(const Book&)>& visit) {
+        std::string direction = descending ? " DESC" : "";
+        int keyColumn = orderBy == "author" ? 2 : 1;
+        return mergeQuery("SELECT id, title, author FROM books ORDER BY " + orderBy + direction
+                              + ", id" + direction + ";",
+                          {},
+                          keyColumn,
+                          descending,
+                          visit);
+    }
+};
+
+// Thread pool where every worker owns a deque of tasks: workers pop their own newest task and,
+// when idle, steal the oldest task of another worker, so uneven chunks still balance out
+class WorkStealingPool {
+   public:
+    // Tasks receive the index of the worker running them, for per-worker resources
+    using Task = std::function<void(size_t worker)>;
+
+   private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex stateMutex;
+    std::condition_variable taskQueued;
+    std::condition_variable allDone;
+    size_t queued = 0;
+    size_t pending = 0;
+    size_t nextQueue = 0;
+    bool stopping = false;
+
+    bool popOrSteal(size_t self, Task& task) {
+        for (size_t i = 0; i < queues.size(); i++) {
+            Queue& queue = *queues[(self + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty()) {
+                continue;
+            }
+            if (i == 0) {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            } else {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void run(size_t self) {
+        while (true) {
+            Task task;
+            if (popOrSteal(self, task)) {
+                {
+                    std::lock_guard<std::mutex> lock(stateMutex);
+                    queued--;
+                }
+                task(self);
+                std::lock_guard<std::mutex> lock(stateMutex);
+                if (--pending == 0) {
+                    allDone.notify_all();
+                }
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(stateMutex);
+            taskQueued.wait(lock, [this] { return stopping || queued > 0; });
+            if (stopping && queued == 0) {
+                return;
+            }
+        }
+    }
+
+   public:
+    explicit WorkStealingPool(size_t threadCount) {
+        for (size_t i = 0; i < threadCount; i++) {
+            queues.push_back(std::make_unique<Queue>());
+        }
+        for (size_t i = 0; i < threadCount; i++) {
+            workers.emplace_back([this, i] { run(i); });
+        }
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            stopping = true;
+        }
+        taskQueued.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    size_t size() const {
+        return workers.size();
+    }
+
+    // Function to queue a task, spreading submissions round-robin over the workers. The counters
+    // go up before the push, as a worker may pop and count the task down as soon as it is queued.
+    void submit(Task task) {
+        size_t target;
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            target = nextQueue++ % queues.size();
+            queued++;
+            pending++;
+        }
+        {
+            std::lock_guard<std::mutex> lock(queues[target]->mutex);
+            queues[target]->tasks.push_back(std::move(task));
+        }
+        taskQueued.notify_one();
+    }
+
+    // Function to block until every submitted task has finished
+    void wait() {
+        std::unique_lock<std::mutex> lock(stateMutex);
+        allDone.wait(lock, [this] { return pending == 0; });
+    }
+};
+
+// LIKE search that splits the rowid range into chunks and scans them in parallel, each worker
+// on its own read-only connection, then concatenates the chunks so rows stay in id order
+class PartitionedScanner {
+   private:
+    std::unique_ptr<WorkStealingPool> pool;
+    std::vector<sqlite3*> readers;
+    std::string path;
+
+    void closeReaders() {
+        for (sqlite3*& reader : readers) {
+            sqlite3_close(reader);
+            reader = nullptr;
+        }
+    }
+
+    // Function to scan one rowid range on the worker's connection, opening it on first use
+    bool scanChunk(size_t worker,
+                   sqlite3_int64 first,
+                   sqlite3_int64 last,
+                   const std::string& pattern,
+                   std::vector<Book>& books) {
+        sqlite3*& reader = readers[worker];
+        if (!reader
+            && sqlite3_open_v2(path.c_str(), &reader, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX,
+                               nullptr)
+                   != SQLITE_OK) {
+            std::cerr << "Cannot open read connection: " << sqlite3_errmsg(reader) << std::endl;
+            sqlite3_close(reader);
+            reader = nullptr;
+            return false;
+        }
+
+        const char* chunkSQL
+            = "SELECT id, title, author FROM books WHERE id BETWEEN ?1 AND ?2 "
+              "AND (title LIKE ?3 OR author LIKE ?3) ORDER BY id;";
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(reader, chunkSQL, -1, &stmt, nullptr) != SQLITE_OK) {
+            handleSqliteError(reader, "prepare statement");
+            return false;
+        }
+        sqlite3_bind_int64(stmt, 1, first);
+        sqlite3_bind_int64(stmt, 2, last);
+        sqlite3_bind_text(stmt, 3, pattern.c_str(), -1, SQLITE_STATIC);
+
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            const unsigned char* title = sqlite3_column_text(stmt, 1);
+            const unsigned char* author = sqlite3_column_text(stmt, 2);
+            books.push_back({static_cast<int>(sqlite3_column_int64(stmt, 0)),
+                             title ? reinterpret_cast<const char*>(title) : "",
+                             author ? reinterpret_cast<const char*>(author) : ""});
+        }
+        if (rc != SQLITE_DONE) {
+            handleSqliteError(reader, "execute statement");
+        }
+        sqlite3_finalize(stmt);
+        return rc == SQLITE_DONE;
+    }
+
+   public:
+    ~PartitionedScanner() {
+        pool.reset();
+        closeReaders();
+    }
+
+    // Function to find books whose title or author matches a LIKE pattern using threadCount
+    // workers. Returns false when the database has no file the workers could open.
+    bool search(sqlite3* db,
+                const std::string& pattern,
+                size_t threadCount,
+                std::vector<Book>& books) {
+        const char* file = sqlite3_db_filename(db, "main");
+        if (!file || !*file) {
+            return false;
+        }
+        if (!pool || pool->size() != threadCount || path != file) {
+            pool = std::make_unique<WorkStealingPool>(threadCount);
+            closeReaders();
+            readers.assign(threadCount, nullptr);
+            path = file;
+        }
+
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(db, "SELECT min(id), max(id) FROM books;", -1, &stmt, nullptr)
+            != SQLITE_OK) {
+            handleSqliteError(db, "prepare statement");
+            return false;
+        }
+        sqlite3_int64 low = 0;
+        sqlite3_int64 high = -1;
+        if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL) {
+            low = sqlite3_column_int64(stmt, 0);
+            high = sqlite3_column_int64(stmt, 1);
+        }
+        sqlite3_finalize(stmt);
+
+        // More chunks than workers, so a worker that finishes early can steal the remainder
+        size_t chunkCount = threadCount * SCAN_CHUNKS_PER_THREAD;
+        sqlite3_int64 span = high - low + 1;
+        sqlite3_int64 chunkSize = std::max<sqlite3_int64>(
+            1, (span + static_cast<sqlite3_int64>(chunkCount) - 1) / chunkCount);
+        std::vector<std::vector<Book>> chunks(chunkCount);
+        std::atomic<bool> failed{false};
+        for (size_t i = 0; i < chunkCount; i++) {
+            sqlite3_int64 first = low + static_cast<sqlite3_int64>(i) * chunkSize;
+            if (first > high) {
+                break;
+            }
+            sqlite3_int64 last = std::min(high, first + chunkSize - 1);
+            pool->submit([this, first, last, &pattern, &chunks, &failed, i](size_t worker) {
+                if (!scanChunk(worker, first, last, pattern, chunks[i])) {
+                    failed = true;
+                }
+            });
+        }
+        pool->wait();
+
+        books.clear();
+        for (std::vector<Book>& chunk : chunks) {
+            books.insert(books.end(), std::make_move_iterator(chunk.begin()),
+                         std::make_move_iterator(chunk.end()));
+        }
+        return !failed;
+    }
+};
+
+// Lazily started coroutine that produces a T. Awaiting it runs the body and resumes the awaiter
+// once the body finishes, on whichever thread the body finished on.
+template <typename T>
+class Task {
+   public:
+    struct promise_type {
+        T value{};
+        std::exception_ptr error;
+        std::coroutine_handle<> continuation = std::noop_coroutine();
+
+        Task get_return_object() {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+        auto final_suspend() noexcept {
+            struct ResumeContinuation {
+                bool await_ready() noexcept {
+                    return false;
+                }
+                std::coroutine_handle<> await_suspend(
+                    std::coroutine_handle<promise_type> handle) noexcept {
+                    return handle.promise().continuation;
+                }
+                void await_resume() noexcept {}
+            };
+            return ResumeContinuation{};
+        }
+        void return_value(T result) {
+            value = std::move(result);
+        }
+        void unhandled_exception() {
+            error = std::current_exception();
+        }
+    };
+
+   private:
+    std::coroutine_handle<promise_type> handle;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+   public:
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept {
+        handle.promise().continuation = awaiter;
+        return handle;
+    }
+    T await_resume() {
+        if (handle.promise().error) {
+            std::rethrow_exception(handle.promise().error);
+        }
+        return std::move(handle.promise().value);
+    }
+};
+
+// Coroutine that produces a stream of values, each fetched with "co_await generator.next()",
+// which yields a pointer to the value or nullptr once the stream is exhausted. The pointer
+// stays valid until the next call.
+template <typename T>
+class AsyncGenerator {
+   public:
+    struct promise_type {
+        const T* current = nullptr;
+        std::exception_ptr error;
+        std::coroutine_handle<> consumer;
+
+        struct ResumeConsumer {
+            bool await_ready() noexcept {
+                return false;
+            }
+            std::coroutine_handle<> await_suspend(
+                std::coroutine_handle<promise_type> handle) noexcept {
+                return handle.promise().consumer;
+            }
+            void await_resume() noexcept {}
+        };
+
+        AsyncGenerator get_return_object() {
+            return AsyncGenerator(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+        ResumeConsumer final_suspend() noexcept {
+            current = nullptr;
+            return {};
+        }
+        ResumeConsumer yield_value(const T& value) noexcept {
+            current = &value;
+            return {};
+        }
+        void return_void() {}
+        void unhandled_exception() {
+            error = std::current_exception();
+        }
+    };
+
+   private:
+    std::coroutine_handle<promise_type> handle;
+
+    explicit AsyncGenerator(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+   public:
+    AsyncGenerator(AsyncGenerator&& other) noexcept
+        : handle(std::exchange(other.handle, nullptr)) {}
+    AsyncGenerator(const AsyncGenerator&) = delete;
+    AsyncGenerator& operator=(const AsyncGenerator&) = delete;
+    ~AsyncGenerator() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    auto next() {
+        struct Advance {
+            std::coroutine_handle<promise_type> handle;
+
+            bool await_ready() noexcept {
+                return handle.done();
+            }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> consumer) noexcept {
+                handle.promise().consumer = consumer;
+                return handle;
+            }
+            const T* await_resume() {
+                if (handle.promise().error) {
+                    std::rethrow_exception(handle.promise().error);
+                }
+                return handle.done() ? nullptr : handle.promise().current;
+            }
+        };
+        return Advance{handle};
+    }
+};
+
+// Coroutine that starts right away and frees itself when it finishes, for top-level requests
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() {
+            return {};
+        }
+        std::suspend_never initial_suspend() noexcept {
+            return {};
+        }
+        std::suspend_never final_suspend() noexcept {
+            return {};
+        }
+        void return_void() {}
+        void unhandled_exception() {
+            std::terminate();
+        }
+    };
+};
+
+// Book store whose operations are coroutines, for callers that cannot block on sqlite3_step.
+// Writes run on a single writer thread that owns the read-write connection, which keeps the
+// in-memory indexes single-writer; lookups and searches run on a pool of reader threads, each
+// with its own read-only connection. Operations reuse the same functions as the menu.
+class AsyncBookStore {
+   private:
+    std::string path;
+    sqlite3* writer = nullptr;
+    std::vector<sqlite3*> readers;
+    std::unique_ptr<WorkStealingPool> writePool;
+    std::unique_ptr<WorkStealingPool> readPool;
+
+    // Awaitable that moves the coroutine onto a pool thread and yields that worker's index
+    struct ResumeOn {
+        WorkStealingPool& pool;
+        size_t worker = 0;
+
+        bool await_ready() noexcept {
+            return false;
+        }
+        void await_suspend(std::coroutine_handle<> handle) {
+            pool.submit([this, handle](size_t index) {
+                worker = index;
+                handle.resume();
+            });
+        }
+        size_t await_resume() noexcept {
+            return worker;
+        }
+    };
+
+    // Function to get the reader connection of a worker, opening it on first use
+    sqlite3* reader(size_t worker) {
+        sqlite3*& db = readers[worker];
+        if (!db
+            && sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX,
+                               nullptr)
+                   != SQLITE_OK) {
+            handleSqliteError(db, "open read connection");
+            sqlite3_close(db);
+            db = nullptr;
+        } else {
+            sqlite3_busy_timeout(db, BUSY_TIMEOUT_MS);
+        }
+        return db;
+    }
+
+   public:
+    ~AsyncBookStore() {
+        writePool.reset();
+        readPool.reset();
+        for (sqlite3* db : readers) {
+            sqlite3_close(db);
+        }
+        sqlite3_close(writer);
+    }
+
+    // Function to open the store on a database file with the given number of reader threads
+    bool open(const std::string& file, size_t readerThreads) {
+        path = file;
+        if (sqlite3_open(path.c_str(), &writer) != SQLITE_OK) {
+            handleSqliteError(writer, "open database");
+            return false;
+        }
+        sqlite3_busy_timeout(writer, BUSY_TIMEOUT_MS);
+        if (!ensureSchema(writer)) {
+            return false;
+        }
+        readers.assign(readerThreads, nullptr);
+        writePool = std::make_unique<WorkStealingPool>(1);
+        readPool = std::make_unique<WorkStealingPool>(readerThreads);
+        return true;
+    }
+
+    size_t threadCount() const {
+        return writePool->size() + readPool->size();
+    }
+
+    // Resolves to the new book's ID, or 0 when it was rejected
+    Task<int> addBook(std::string title, std::string author) {
+        co_await ResumeOn{*writePool};
+        co_return insertBook(writer, title, author);
+    }
+
+    Task<std::optional<Book>> getBook(int bookId) {
+        size_t worker = co_await ResumeOn{*readPool};
+        Book book;
+        sqlite3* db = reader(worker);
+        if (!db || !fetchBook(db, bookId, book)) {
+            co_return std::nullopt;
+        }
+        co_return book;
+    }
+
+    Task<bool> updateBook(int bookId, std::string title, std::string author) {
+        co_await ResumeOn{*writePool};
+        Book current;
+        co_return fetchBook(writer, bookId, current) && changeBook(writer, current, title, author);
+    }
+
+    Task<bool> deleteBook(int bookId) {
+        co_await ResumeOn{*writePool};
+        Book current;
+        co_return fetchBook(writer, bookId, current) && removeBook(writer, current);
+    }
+
+    // Streams the books whose title or author contains the term, in ID order. Rows are read in
+    // batches on the reader pool, resuming after the last ID, so no statement or read
+    // transaction is held while the consumer works through a batch.
+    AsyncGenerator<Book> searchBooks(std::string searchTerm) {
+        std::string pattern = "%" + searchTerm + "%";
+        std::vector<Book> batch;
+        int lastId = 0;
+        do {
+            size_t worker = co_await ResumeOn{*readPool};
+            batch.clear();
+            sqlite3* db = reader(worker);
+            if (!db
+                || !findBooks(db, pattern, lastId, ASYNC_SEARCH_BATCH,
+                              [&batch](const Book& book) { batch.push_back(book); })) {
+                co_return;
+            }
+            for (const Book& book : batch) {
+                co_yield book;
+            }
+            if (!batch.empty()) {
+                lastId = batch.back().id;
+            }
+        } while (batch.size() == static_cast<size_t>(ASYNC_SEARCH_BATCH));
+    }
+};
+
+// Global parallel scanner for wildcard searches, using --search-threads workers
+PartitionedScanner partitionedScanner;
+size_t searchThreads = std::max(1u, std::thread::hardware_concurrency());
+
+// Sort orders offered by the export; each maps a book to a byte key compared with memcmp
+enum ExportOrder {
+    EXPORT_BY_TITLE,
+    EXPORT_BY_AUTHOR,
+    EXPORT_BY_TITLE_NOCASE,
+    EXPORT_BY_AUTHOR_NOCASE,
+    EXPORT_BY_TITLE_LENGTH
+};
+
+// External merge sort of books on a byte key within a memory budget. Rows are appended to an
+// arena as records, each laid out in host byte order as
+//   uint32 key length | key | int64 id | uint32 length | title | uint32 length | author
+// and indexed by 16-byte entries holding the first 8 key bytes as a big-endian integer, so most
+// comparisons never leave the entry array. A full arena is sorted and spilled to a temporary
+// file as a run in the same layout; finish() then merges the runs with a heap of run readers.
+// Ties on the key are broken by ascending id.
+class ExternalSorter {
+   private:
+    struct Entry {
+        uint64_t prefix;
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    // Position in a spilled run, holding its current record. Reads go through a buffer of our
+    // own sized from the budget, since the stream was already used for writing the run.
+    struct RunReader {
+        FILE* file = nullptr;
+        std::vector<char> buffer;
+        size_t position = 0;
+        size_t filled = 0;
+        std::string record;
+        std::string_view key;
+        int64_t id = 0;
+
+        // Function to append count bytes of the run to the record
+        bool read(size_t count) {
+            while (count > 0) {
+                if (position == filled) {
+                    filled = std::fread(buffer.data(), 1, buffer.size(), file);
+                    position = 0;
+                    if (filled == 0) {
+                        return false;
+                    }
+                }
+                size_t chunk = std::min(count, filled - position);
+                record.append(buffer.data() + position, chunk);
+                position += chunk;
+                count -= chunk;
+            }
+            return true;
+        }
+    };
+
+    size_t memoryBudget;
+    bool descending;
+    std::string arena;
+    std::vector<Entry> entries;
+    std::vector<FILE*> runs;
+    uint64_t spilled = 0;
+    bool failed = false;
+
+    static uint64_t keyPrefix(std::string_view key) {
+        uint64_t prefix = 0;
+        for (size_t i = 0; i < 8; i++) {
+            prefix = prefix << 8 | (i < key.size() ? static_cast<unsigned char>(key[i]) : 0);
+        }
+        return prefix;
+    }
+
+    static uint32_t readLength(const char* at) {
+        uint32_t length;
+        std::memcpy(&length, at, sizeof(length));
+        return length;
+    }
+
+    static std::string_view recordKey(const char* record) {
+        return std::string_view(record + sizeof(uint32_t), readLength(record));
+    }
+
+    static int64_t recordId(const char* record) {
+        int64_t id;
+        std::memcpy(&id, record + sizeof(uint32_t) + readLength(record), sizeof(id));
+        return id;
+    }
+
+    static Book recordBook(const char* record) {
+        const char* at = record + sizeof(uint32_t) + readLength(record) + sizeof(int64_t);
+        uint32_t titleLength = readLength(at);
+        std::string title(at + sizeof(uint32_t), titleLength);
+        at += sizeof(uint32_t) + titleLength;
+        std::string author(at + sizeof(uint32_t), readLength(at));
+        return {static_cast<int>(recordId(record)), std::move(title), std::move(author)};
+    }
+
+    // Function to order two rows by key in the requested direction, then by ascending id
+    bool before(std::string_view keyA, int64_t idA, std::string_view keyB, int64_t idB) const {
+        int order = keyA.compare(keyB);
+        if (order == 0) {
+            return idA < idB;
+        }
+        return descending ? order > 0 : order < 0;
+    }
+
+    void sortEntries() {
+        std::sort(entries.begin(), entries.end(), [this](const Entry& a, const Entry& b) {
+            if (a.prefix != b.prefix) {
+                return descending ? a.prefix > b.prefix : a.prefix < b.prefix;
+            }
+            const char* recordA = arena.data() + a.offset;
+            const char* recordB = arena.data() + b.offset;
+            return before(recordKey(recordA), recordId(recordA), recordKey(recordB),
+                          recordId(recordB));
+        });
+    }
+
+    // Function to sort the arena and write it out as a run in a temporary file
+    bool spill() {
+        sortEntries();
+        FILE* run = std::tmpfile();
+        if (!run) {
+            std::cerr << "Cannot create a temporary file for the sort: " << std::strerror(errno)
+                      << std::endl;
+            return false;
+        }
+        runs.push_back(run);
+        for (const Entry& entry : entries) {
+            if (std::fwrite(arena.data() + entry.offset, 1, entry.size, run) != entry.size) {
+                std::cerr << "Cannot write a sort run: " << std::strerror(errno) << std::endl;
+                return false;
+            }
+        }
+        spilled += arena.size();
+        arena.clear();
+        entries.clear();
+        return std::fflush(run) == 0 && std::fseek(run, 0, SEEK_SET) == 0;
+    }
+
+    // Function to load the next record of a run, returning false at its end
+    static bool advance(RunReader& reader) {
+        reader.record.clear();
+        if (!reader.read(sizeof(uint32_t))) {
+            return false;
+        }
+        uint32_t keyLength = readLength(reader.record.data());
+        if (!reader.read(keyLength + sizeof(int64_t) + sizeof(uint32_t))) {
+            return false;
+        }
+        // The title and author lengths each sit right before their bytes
+        for (int field = 0; field < 2; field++) {
+            uint32_t length
+                = readLength(reader.record.data() + reader.record.size() - sizeof(uint32_t));
+            if (!reader.read(length + (field == 0 ? sizeof(uint32_t) : 0))) {
+                return false;
+            }
+        }
+        reader.key = recordKey(reader.record.data());
+        reader.id = recordId(reader.record.data());
+        return true;
+    }
+
+   public:
+    ExternalSorter(size_t memoryBudget, bool descending)
+        : memoryBudget(std::min<size_t>(memoryBudget, std::numeric_limits<uint32_t>::max())),
+          descending(descending) {}
+
+    ~ExternalSorter() {
+        for (FILE* run : runs) {
+            std::fclose(run);
+        }
+    }
+
+    size_t runCount() const {
+        return runs.size();
+    }
+
+    uint64_t spilledBytes() const {
+        return spilled;
+    }
+
+    bool add(std::string_view key, const Book& book) {
+        size_t size = 3 * sizeof(uint32_t) + sizeof(int64_t) + key.size() + book.title.size()
+                      + book.author.size();
+        if (failed
+            || (!entries.empty()
+                && arena.size() + size + (entries.size() + 1) * sizeof(Entry) > memoryBudget
+                && !spill())) {
+            failed = true;
+            return false;
+        }
+
+        entries.push_back({keyPrefix(key), static_cast<uint32_t>(arena.size()),
+                           static_cast<uint32_t>(size)});
+        auto appendField = [this](std::string_view value) {
+            uint32_t length = static_cast<uint32_t>(value.size());
+            arena.append(reinterpret_cast<const char*>(&length), sizeof(length));
+            arena.append(value);
+        };
+        appendField(key);
+        int64_t id = book.id;
+        arena.append(reinterpret_cast<const char*>(&id), sizeof(id));
+        appendField(book.title);
+        appendField(book.author);
+        return true;
+    }
+
+    // Function to visit every added book in sorted order
+    bool finish(const std::function<void(const Book&)>& visit) {
+        if (failed) {
+            return false;
+        }
+        if (runs.empty()) {
+            sortEntries();
+            for (const Entry& entry : entries) {
+                visit(recordBook(arena.data() + entry.offset));
+            }
+            return true;
+        }
+        if (!entries.empty() && !spill()) {
+            return false;
+        }
+        std::string().swap(arena);
+        std::vector<Entry>().swap(entries);
+
+        // Split the budget into one read buffer per run
+        size_t bufferSize = std::clamp<size_t>(memoryBudget / runs.size(), 4096, 1 << 20);
+        std::vector<RunReader> readers(runs.size());
+        std::vector<size_t> heap;
+        auto after = [this, &readers](size_t a, size_t b) {
+            return before(readers[b].key, readers[b].id, readers[a].key, readers[a].id);
+        };
+        for (size_t i = 0; i < runs.size(); i++) {
+            readers[i].file = runs[i];
+            readers[i].buffer.resize(bufferSize);
+            if (advance(readers[i])) {
+                heap.push_back(i);
+            }
+        }
+        std::make_heap(heap.begin(), heap.end(), after);
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), after);
+            RunReader& reader = readers[heap.back()];
+            visit(recordBook(reader.record.data()));
+            if (advance(reader)) {
+                std::push_heap(heap.begin(), heap.end(), after);
+            } else {
+                heap.pop_back();
+            }
+        }
+        return true;
+    }
+};
+
+// Background job that takes an online backup at a fixed interval until it is stopped
+class BackupScheduler {
+   private:
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    bool stopping = false;
+
+   public:
+    ~BackupScheduler() {
+        stop();
+    }
+
+    void start(sqlite3* db, const std::string& destination, std::chrono::seconds interval) {
+        start(destination, interval,
+              [db, destination] { return backupDatabase(db, destination, nullptr); });
+    }
+
+    // Function to run another kind of backup on the schedule, such as the snapshots of an
+    // in-memory database
+    void start(const std::string& destination,
+               std::chrono::seconds interval,
+               const std::function<bool()>& backup) {
+        worker = std::thread([this, destination, interval, backup] {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!wakeUp.wait_for(lock, interval, [this] { return stopping; })) {
+                lock.unlock();
+                logEvent(INFO, LOG_EVENT_BACKUP_STARTED, {destination});
+                auto start = std::chrono::steady_clock::now();
+                bool ok = backup();
+                auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - start);
+                logEvent(ok ? INFO : ERROR, LOG_EVENT_BACKUP_FINISHED,
+                         {destination, ok ? "finished" : "failed", elapsed.count()});
+                lock.lock();
+            }
+        });
+    }
+
+    void stop() {
+        if (worker.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wakeUp.notify_all();
+            worker.join();
+        }
+    }
+};
+
+// Background job that returns free pages to the file system a slice at a time and refreshes
+// the query planner statistics now and then. It works on its own connection, so each slice is
+// a short write transaction that the menu's writes simply wait out.
+class MaintenanceScheduler {
+   private:
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    bool stopping = false;
+
+    // Function to pause between slices, returning false once the scheduler is stopping
+    bool pause(std::chrono::milliseconds duration) {
+        std::unique_lock<std::mutex> lock(mutex);
+        return !wakeUp.wait_for(lock, duration, [this] { return stopping; });
+    }
+
+    // Function to release the free pages in slices; returns the number released
+    int vacuumFreePages(sqlite3* db) {
+        int released = 0;
+        int freePages;
+        while ((freePages = pragmaValue(db, "freelist_count")) > 0) {
+            std::string vacuumSQL = "PRAGMA incremental_vacuum("
+                                    + std::to_string(MAINTENANCE_VACUUM_PAGES) + ");";
+            if (sqlite3_exec(db, vacuumSQL.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK) {
+                handleSqliteError(db, "incremental vacuum");
+                break;
+            }
+            released += freePages - std::max(pragmaValue(db, "freelist_count"), 0);
+            if (!pause(std::chrono::milliseconds(MAINTENANCE_SLICE_PAUSE_MS))) {
+                break;
+            }
+        }
+        return released;
+    }
+
+   public:
+    ~MaintenanceScheduler() {
+        stop();
+    }
+
+    void start(const std::string& path, std::chrono::seconds interval) {
+        worker = std::thread([this, path, interval] {
+            sqlite3* db;
+            if (sqlite3_open(path.c_str(), &db) != SQLITE_OK) {
+                handleSqliteError(db, "open maintenance connection");
+                sqlite3_close(db);
+                return;
+            }
+            sqlite3_busy_timeout(db, BUSY_TIMEOUT_MS);
+            if (pragmaValue(db, "auto_vacuum") != AUTO_VACUUM_INCREMENTAL) {
+                writeToLog(WARNING,
+                           "Free pages cannot be released until the database is converted with "
+                           "\"vacuum-migrate\".");
+            }
+
+            for (int tick = 1; pause(interval); tick++) {
+                auto start = std::chrono::steady_clock::now();
+                int released = 0;
+                if (pragmaValue(db, "auto_vacuum") == AUTO_VACUUM_INCREMENTAL) {
+                    released = vacuumFreePages(db);
+                }
+                bool analyzed = tick % MAINTENANCE_ANALYZE_EVERY == 0;
+                if (analyzed) {
+                    std::string analyzeSQL = "PRAGMA analysis_limit = "
+                                             + std::to_string(MAINTENANCE_ANALYSIS_LIMIT)
+                                             + "; ANALYZE; PRAGMA optimize;";
+                    if (sqlite3_exec(db, analyzeSQL.c_str(), nullptr, nullptr, nullptr)
+                        != SQLITE_OK) {
+                        handleSqliteError(db, "analyze");
+                    }
+                }
+                auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - start);
+                logEvent(INFO, LOG_EVENT_MAINTENANCE,
+                         {released, analyzed ? " and refreshed statistics" : "", elapsed.count()});
+            }
+            sqlite3_close(db);
+        });
+    }
+
+    void stop() {
+        if (worker.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wakeUp.notify_all();
+            worker.join();
+        }
+    }
+};
+
+// Registry of the process metrics. Updates are relaxed atomic increments, so the menu, the
+// background jobs and the search threads never wait on each other to record them; rendering
+// reads the counters one by one, so a dump taken mid-operation may be off by that operation.
+class MetricsRegistry {
+   private:
+    struct Histogram {
+        std::atomic<uint64_t> buckets[METRIC_LATENCY_BUCKETS + 1]{};  // the last one is +Inf
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> sumMicroseconds{0};
+    };
+
+    Histogram latency[METRIC_OPERATION_COUNT];
+    std::atomic<uint64_t> failures[METRIC_OPERATION_COUNT]{};
+    std::atomic<uint64_t> cacheHits[METRIC_CACHE_COUNT]{};
+    std::atomic<uint64_t> cacheMisses[METRIC_CACHE_COUNT]{};
+    std::atomic<uint64_t> rowsRead{0};
+    std::atomic<uint64_t> rowsWritten{0};
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+
+    // Function to write the HELP and TYPE lines that introduce a metric
+    static void describe(std::ostringstream& out, const char* name, const char* type,
+                         const char* help) {
+        out << "# HELP " << name << " " << help << "\n# TYPE " << name << " " << type << "\n";
+    }
+
+   public:
+    // Function to record a finished operation and how long it took
+    void observe(MetricOperation operation, std::chrono::steady_clock::duration elapsed,
+                 bool ok = true) {
+        uint64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+        size_t bucket = 0;
+        while (bucket < METRIC_LATENCY_BUCKETS && micros > METRIC_LATENCY_BOUNDS_US[bucket]) {
+            bucket++;
+        }
+        Histogram& histogram = latency[operation];
+        histogram.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        histogram.count.fetch_add(1, std::memory_order_relaxed);
+        histogram.sumMicroseconds.fetch_add(micros, std::memory_order_relaxed);
+        if (!ok) {
+            failures[operation].fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void addRowsRead(uint64_t rows) {
+        rowsRead.fetch_add(rows, std::memory_order_relaxed);
+    }
+
+    void addRowsWritten(uint64_t rows) {
+        rowsWritten.fetch_add(rows, std::memory_order_relaxed);
+    }
+
+    void cacheHit(MetricCache cache) {
+        cacheHits[cache].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void cacheMiss(MetricCache cache) {
+        cacheMisses[cache].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Function to render every metric in the Prometheus text exposition format, adding the
+    // SQLite memory and page cache figures of the connection as gauges and counters
+    std::string render(sqlite3* db) const {
+        std::ostringstream out;
+        auto load = [](const std::atomic<uint64_t>& value) {
+            return value.load(std::memory_order_relaxed);
+        };
+
+        describe(out, "books_operations_total", "counter", "Operations completed, by type.");
+        for (int op = 0; op < METRIC_OPERATION_COUNT; op++) {
+            out << "books_operations_total{operation=\"" << METRIC_OPERATION_NAMES[op] << "\"} "
+                << load(latency[op].count) << "\n";
+        }
+        describe(out, "books_operation_failures_total", "counter", "Operations that failed.");
+        for (int op = 0; op < METRIC_OPERATION_COUNT; op++) {
+            out << "books_operation_failures_total{operation=\"" << METRIC_OPERATION_NAMES[op]
+                << "\"} " << load(failures[op]) << "\n";
+        }
+        describe(out, "books_operation_duration_seconds", "histogram",
+                 "Time spent in each operation.");
+        for (int op = 0; op < METRIC_OPERATION_COUNT; op++) {
+            std::string labels = std::string("operation=\"") + METRIC_OPERATION_NAMES[op] + "\"";
+            uint64_t cumulative = 0;
+            for (size_t bucket = 0; bucket <= METRIC_LATENCY_BUCKETS; bucket++) {
+                cumulative += load(latency[op].buckets[bucket]);
+                out << "books_operation_duration_seconds_bucket{" << labels << ",le=\"";
+                if (bucket < METRIC_LATENCY_BUCKETS) {
+                    out << METRIC_LATENCY_BOUNDS_US[bucket] / 1e6;
+                } else {
+                    out << "+Inf";
+                }
+                out << "\"} " << cumulative << "\n";
+            }
+            out << "books_operation_duration_seconds_sum{" << labels << "} "
+                << load(latency[op].sumMicroseconds) / 1e6 << "\n"
+                << "books_operation_duration_seconds_count{" << labels << "} "
+                << load(latency[op].count) << "\n";
+        }
+
+        describe(out, "books_rows_read_total", "counter", "Books read by views and searches.");
+        out << "books_rows_read_total " << load(rowsRead) << "\n";
+        describe(out, "books_rows_written_total", "counter", "Books inserted, updated or deleted.");
+        out << "books_rows_written_total " << load(rowsWritten) << "\n";
+        describe(out, "books_cache_hits_total", "counter",
+                 "Lookups answered by an in-memory index or filter.");
+        for (int cache = 0; cache < METRIC_CACHE_COUNT; cache++) {
+            out << "books_cache_hits_total{cache=\"" << METRIC_CACHE_NAMES[cache] << "\"} "
+                << load(cacheHits[cache]) << "\n";
+        }
+        describe(out, "books_cache_misses_total", "counter",
+                 "Lookups that had to build an index or query SQLite.");
+        for (int cache = 0; cache < METRIC_CACHE_COUNT; cache++) {
+            out << "books_cache_misses_total{cache=\"" << METRIC_CACHE_NAMES[cache] << "\"} "
+                << load(cacheMisses[cache]) << "\n";
+        }
+
+        sqlite3_int64 current = 0, highwater = 0;
+        sqlite3_status64(SQLITE_STATUS_MEMORY_USED, &current, &highwater, 0);
+        describe(out, "books_sqlite_memory_used_bytes", "gauge", "Memory held by SQLite.");
+        out << "books_sqlite_memory_used_bytes " << current << "\n";
+        describe(out, "books_sqlite_memory_highwater_bytes", "gauge",
+                 "Most memory SQLite has held at once.");
+        out << "books_sqlite_memory_highwater_bytes " << highwater << "\n";
+        sqlite3_status64(SQLITE_STATUS_PAGECACHE_OVERFLOW, &current, &highwater, 0);
+        describe(out, "books_sqlite_pagecache_overflow_bytes", "gauge",
+                 "Page cache memory that did not fit the configured page cache pool.");
+        out << "books_sqlite_pagecache_overflow_bytes " << current << "\n";
+
+        const std::pair<int, const char*> pageCache[] = {
+            {SQLITE_DBSTATUS_CACHE_HIT, "hits"},
+            {SQLITE_DBSTATUS_CACHE_MISS, "misses"},
+            {SQLITE_DBSTATUS_CACHE_WRITE, "writes"},
+        };
+        int used = 0, unused = 0;
+        sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_USED, &used, &unused, 0);
+        describe(out, "books_sqlite_page_cache_used_bytes", "gauge",
+                 "Page cache memory of the main connection.");
+        out << "books_sqlite_page_cache_used_bytes " << used << "\n";
+        describe(out, "books_sqlite_page_cache_total", "counter",
+                 "Page cache hits, misses and writes of the main connection.");
+        for (const auto& [status, name] : pageCache) {
+            int value = 0;
+            sqlite3_db_status(db, status, &value, &unused, 0);
+            out << "books_sqlite_page_cache_total{event=\"" << name << "\"} " << value << "\n";
+        }
+
+        describe(out, "books_uptime_seconds", "gauge", "Time since the process started.");
+        out << "books_uptime_seconds "
+            << std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now()
+                                                                - started)
+                   .count()
+            << "\n";
+        return out.str();
+    }
+};
+
+// Global metrics, updated from any thread
+MetricsRegistry metrics;
+
+// Times an operation from construction to destruction and records it in the metrics, as a
+// failure unless succeeded() was called on the way out
+class OperationTimer {
+   private:
+    MetricOperation operation;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool ok = false;
+
+   public:
+    explicit OperationTimer(MetricOperation operation) : operation(operation) {}
+
+    ~OperationTimer() {
+        metrics.observe(operation, std::chrono::steady_clock::now() - start, ok);
+    }
+
+    void succeeded() {
+        ok = true;
+    }
+};
+
+// SQLite resources that one operation type has used, summed over its runs
+struct ResourceUsage {
+    uint64_t runs = 0;
+    uint64_t statements = 0;
+    uint64_t vmSteps = 0;
+    uint64_t fullScanSteps = 0;
+    uint64_t sorts = 0;
+    uint64_t autoIndexes = 0;
+    uint64_t cacheHits = 0;
+    uint64_t cacheMisses = 0;
+    uint64_t cacheWrites = 0;
+};
+
+// Per-operation accounting of SQLite's own counters for capacity planning. A profile trace on
+// the connection collects each statement's sqlite3_stmt_status counters as it finishes and
+// charges them to the operation running on that thread; page cache figures are
+// sqlite3_db_status deltas across the whole operation.
+class ResourceAccounting {
+   private:
+    std::mutex mutex;
+    ResourceUsage usage[METRIC_OPERATION_COUNT];
+
+    static int onStatementFinished(unsigned type, void* context, void* statement, void*) {
+        if (type == SQLITE_TRACE_PROFILE && currentOperation >= 0) {
+            auto* accounting = static_cast<ResourceAccounting*>(context);
+            auto* stmt = static_cast<sqlite3_stmt*>(statement);
+            std::lock_guard<std::mutex> lock(accounting->mutex);
+            ResourceUsage& used = accounting->usage[currentOperation];
+            used.statements++;
+            used.vmSteps += sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_VM_STEP, 1);
+            used.fullScanSteps += sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+            used.sorts += sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_SORT, 1);
+            used.autoIndexes += sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_AUTOINDEX, 1);
+        }
+        return 0;
+    }
+
+   public:
+    // Operation whose statements the current thread is running, or -1 outside of one
+    static inline thread_local int currentOperation = -1;
+
+    // Function to start collecting statement counters on a connection
+    bool attach(sqlite3* db) {
+        return sqlite3_trace_v2(db, SQLITE_TRACE_PROFILE, onStatementFinished, this) == SQLITE_OK;
+    }
+
+    // Function to add one finished run of an operation with its page cache deltas
+    void finish(MetricOperation operation, int cacheHits, int cacheMisses, int cacheWrites) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ResourceUsage& used = usage[operation];
+        used.runs++;
+        used.cacheHits += std::max(cacheHits, 0);
+        used.cacheMisses += std::max(cacheMisses, 0);
+        used.cacheWrites += std::max(cacheWrites, 0);
+    }
+
+    // Function to print a table of the operations that ran, with totals and per-run averages
+    void print(std::ostream& out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        out << std::left << std::setw(8) << "Op" << std::right << std::setw(6) << "Runs"
+            << std::setw(8) << "Stmts" << std::setw(12) << "VM steps" << std::setw(12)
+            << "Scan steps" << std::setw(7) << "Sorts" << std::setw(9) << "Autoidx"
+            << std::setw(11) << "Cache hit" << std::setw(12) << "Cache miss" << std::setw(13)
+            << "Cache write" << std::setw(15) << "Steps per run" << "\n";
+        for (int op = 0; op < METRIC_OPERATION_COUNT; op++) {
+            const ResourceUsage& used = usage[op];
+            if (used.runs == 0) {
+                continue;
+            }
+            out << std::left << std::setw(8) << METRIC_OPERATION_NAMES[op] << std::right
+                << std::setw(6) << used.runs << std::setw(8) << used.statements << std::setw(12)
+                << used.vmSteps << std::setw(12) << used.fullScanSteps << std::setw(7)
+                << used.sorts << std::setw(9) << used.autoIndexes << std::setw(11)
+                << used.cacheHits << std::setw(12) << used.cacheMisses << std::setw(13)
+                << used.cacheWrites << std::setw(15) << used.vmSteps / used.runs << "\n";
+        }
+    }
+
+    // Function to describe each operation that ran on a line of its own, for the log
+    std::vector<std::string> summaryLines() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<std::string> lines;
+        for (int op = 0; op < METRIC_OPERATION_COUNT; op++) {
+            const ResourceUsage& used = usage[op];
+            if (used.runs == 0) {
+                continue;
+            }
+            std::ostringstream line;
+            line << "SQLite resources for " << METRIC_OPERATION_NAMES[op] << ": " << used.runs
+                 << " runs, " << used.statements << " statements, " << used.vmSteps
+                 << " VM steps, " << used.fullScanSteps << " scan steps, " << used.sorts
+                 << " sorts, " << used.autoIndexes << " automatic indexes, " << used.cacheHits
+                 << " cache hits, " << used.cacheMisses << " cache misses, " << used.cacheWrites
+                 << " cache writes, " << used.vmSteps / used.runs << " steps per run.";
+            lines.push_back(line.str());
+        }
+        return lines;
+    }
+};
+
+// Global resource accounting of the interactive session
+ResourceAccounting resourceAccounting;
+
+// Function to print the session's resource table and log it one operation per line; does
+// nothing when no operation ran
+void reportResourceUsage() {
+    std::vector<std::string> lines = resourceAccounting.summaryLines();
+    if (lines.empty()) {
+        return;
+    }
+    std::cout << "\nSQLite resources by operation:\n";
+    resourceAccounting.print(std::cout);
+    for (const std::string& line : lines) {
+        writeToLog(INFO, line);
+    }
+}
+
+// Charges the statements run on this thread from construction to destruction to an operation,
+// together with the connection's page cache counters over the same span
+class ResourceScope {
+   private:
+    sqlite3* db;
+    MetricOperation operation;
+    int previousOperation;
+    int cacheHits, cacheMisses, cacheWrites;
+
+    // Function to read one of the connection's cumulative page cache counters
+    int cacheCounter(int status) {
+        int current = 0, highwater = 0;
+        sqlite3_db_status(db, status, &current, &highwater, 0);
+        return current;
+    }
+
+   public:
+    ResourceScope(sqlite3* db, MetricOperation operation)
+        : db(db), operation(operation), previousOperation(ResourceAccounting::currentOperation) {
+        ResourceAccounting::currentOperation = operation;
+        cacheHits = cacheCounter(SQLITE_DBSTATUS_CACHE_HIT);
+        cacheMisses = cacheCounter(SQLITE_DBSTATUS_CACHE_MISS);
+        cacheWrites = cacheCounter(SQLITE_DBSTATUS_CACHE_WRITE);
+    }
+
+    ~ResourceScope() {
+        resourceAccounting.finish(operation, cacheCounter(SQLITE_DBSTATUS_CACHE_HIT) - cacheHits,
+                                  cacheCounter(SQLITE_DBSTATUS_CACHE_MISS) - cacheMisses,
+                                  cacheCounter(SQLITE_DBSTATUS_CACHE_WRITE) - cacheWrites);
+        ResourceAccounting::currentOperation = previousOperation;
+    }
+};
+
+// Set by the SIGUSR1 handler, which may do nothing but flip a lock-free flag
+std::atomic<bool> metricsRequested{false};
+
+// Background job that writes the metrics to a file whenever the process receives SIGUSR1, and
+// once more when it stops. The file is replaced by a rename, so a reader never sees half a dump.
+class MetricsExporter {
+   private:
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    bool stopping = false;
+
+    // Function to write the current metrics to the file
+    static void dump(sqlite3* db, const std::string& path) {
+        std::string temporary = path + ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::trunc);
+            out << metrics.render(db);
+            if (!out) {
+                writeToLog(ERROR, "Cannot write metrics to " + temporary + ".");
+                return;
+            }
+        }
+        if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+            writeToLog(ERROR, "Cannot replace " + path + ": " + std::strerror(errno));
+        }
+    }
+
+   public:
+    ~MetricsExporter() {
+        stop();
+    }
+
+    void start(sqlite3* db, const std::string& path) {
+#ifdef SIGUSR1
+        std::signal(SIGUSR1, [](int) { metricsRequested.store(true); });
+#endif
+        worker = std::thread([this, db, path] {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!wakeUp.wait_for(lock, std::chrono::milliseconds(LOG_POLL_MS),
+                                    [this] { return stopping; })) {
+                if (metricsRequested.exchange(false)) {
+                    lock.unlock();
+                    dump(db, path);
+                    lock.lock();
+                }
+            }
+            lock.unlock();
+            dump(db, path);
+        });
+    }
+
+    void stop() {
+        if (worker.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wakeUp.notify_all();
+            worker.join();
+        }
+    }
+};
+
+// Times the phases of startup for "main startup-timing", from the start of main
+class StartupTimer {
+   private:
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point last = start;
+    std::vector<std::pair<const char*, std::chrono::nanoseconds>> phases;
+
+   public:
+    // Function to end the current phase under the given name
+    void mark(const char* phase) {
+        auto now = std::chrono::steady_clock::now();
+        phases.emplace_back(phase, now - last);
+        last = now;
+    }
+
+    void report(std::ostream& out) const {
+        out << std::fixed << std::setprecision(1);
+        for (const auto& [phase, elapsed] : phases) {
+            out << std::left << std::setw(20) << phase << std::right << std::setw(10)
+                << elapsed.count() / 1000.0 << " us\n";
+        }
+        out << std::left << std::setw(20) << "total" << std::right << std::setw(10)
+            << std::chrono::duration_cast<std::chrono::nanoseconds>(last - start).count() / 1000.0
+            << " us\n"
+            << std::defaultfloat;
+    }
+};
+
+int main(int argc, char* argv[]) {
+    StartupTimer startup;
+    std::vector<std::string> args(argv + 1, argv + argc);
+
+    try {
+        // "main log-bench [iterations]" compares the cost of log timestamps and of whole events
+        if (!args.empty() && args[0] == "log-bench") {
+            if (args.size() > 2) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            long long iterations = args.size() == 2 ? std::stoll(args[1]) : LOG_BENCH_ITERATIONS;
+            if (iterations < 1) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            return benchmarkLogTimestamps(static_cast<size_t>(iterations));
+        }
+
+        // "main vfs-bench [rounds]" times full scans of books.db through the default and the
+        // io_uring VFS, with the file evicted from the page cache and again with it cached
+        if (!args.empty() && args[0] == "vfs-bench") {
+            if (args.size() > 2) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            int rounds = args.size() == 2 ? std::stoi(args[1]) : VFS_BENCH_ROUNDS;
+            return benchmarkVfs(DATABASE_PATH, rounds);
+        }
+
+        // "main async-bench <file> <requests> [--readers <n>]" exercises the coroutine API
+        if (!args.empty() && args[0] == "async-bench") {
+            if (args.size() != 3 && !(args.size() == 5 && args[3] == "--readers")) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            long long requests = std::stoll(args[2]);
+            size_t readers = ASYNC_BENCH_READERS;
+            if (requests < 1 || (args.size() == 5 && !parseThreadCount(args[4], readers))) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            return runAsyncBenchmark(args[1], static_cast<size_t>(requests), readers);
+        }
+
+        // "main changes [--from <sequence>] [--follow]" reads the change log without the database
+        if (!args.empty() && args[0] == "changes") {
+            uint64_t fromSequence = 0;
+            bool follow = false;
+            for (size_t i = 1; i < args.size(); i++) {
+                if (args[i] == "--from" && i + 1 < args.size()) {
+                    fromSequence = std::stoull(args[++i]);
+                } else if (args[i] == "--follow") {
+                    follow = true;
+                } else {
+                    printUsage(argv[0]);
+                    return 1;
+                }
+            }
+            return tailChangeLog(CHANGE_LOG_PATH, fromSequence, follow);
+        }
+
+        // "main --shards <n> <command> ..." works on a catalog split over n database files
+        if (args.size() >= 3 && args[0] == "--shards") {
+            int shardCount = std::stoi(args[1]);
+            if (shardCount < 1) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            return runShardCommand(shardCount,
+                                   std::vector<std::string>(args.begin() + 2, args.end()), argv[0]);
+        }
+
+#ifdef SQLITE_ENABLE_SESSION
+        // "main replication-bench [updates]" times publishing and applying single-row updates
+        // on scratch files, leaving books.db alone
+        if (!args.empty() && args[0] == "replication-bench") {
+            if (args.size() > 2) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            return benchmarkReplication(args.size() == 2 ? std::stoi(args[1])
+                                                         : REPLICATION_BENCH_UPDATES);
+        }
+#endif
+
+        // --in-memory decides how the database is opened, so it is picked out before the
+        // other options
+        bool inMemory = std::find(args.begin(), args.end(), "--in-memory") != args.end();
+
+        // --uring-vfs likewise has to be the default VFS before the database is opened
+        if (std::find(args.begin(), args.end(), "--uring-vfs") != args.end()) {
+            registerUringVfs(true);
+        }
+        DatabaseConnection dbConnection(inMemory);
+        sqlite3* db = dbConnection.get();
+        sqlite3_busy_timeout(db, BUSY_TIMEOUT_MS);
+        startup.mark("open database");
+
+        if (!ensureSchema(db)) {
+            return 1;
+        }
+        startup.mark("check schema");
+
+        if (!registerColumnarBooks(db)) {
+            handleSqliteError(db, "columnar table registration");
+            return 1;
+        }
+        startup.mark("register modules");
+
+        // "main startup-timing" reports how long each startup phase took and exits
+        if (!args.empty() && args[0] == "startup-timing") {
+            startup.report(std::cout);
+            return 0;
+        }
+
+        // "main top-authors [--limit <k>]" lists the authors with the most books and exits
+        if (!args.empty() && args[0] == "top-authors") {
+            if (args.size() != 1 && !(args.size() == 3 && args[1] == "--limit")) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            listTopAuthors(db, args.size() == 3 ? std::stoi(args[2]) : TOP_AUTHORS_LIMIT);
+            return 0;
+        }
+
+        // "main check-author-stats [--rounds <n>] [--seed <s>]" cross-checks author_stats against
+        // GROUP BY under random writes, rolled back afterwards
+        if (!args.empty() && args[0] == "check-author-stats") {
+            int rounds = AUTHOR_STATS_CHECK_ROUNDS;
+            unsigned seed = std::random_device{}();
+            for (size_t i = 1; i < args.size(); i++) {
+                if (args[i] == "--rounds" && i + 1 < args.size()) {
+                    rounds = std::stoi(args[++i]);
+                } else if (args[i] == "--seed" && i + 1 < args.size()) {
+                    seed = static_cast<unsigned>(std::stoul(args[++i]));
+                } else {
+                    printUsage(argv[0]);
+                    return 1;
+                }
+            }
+            return checkAuthorStats(db, rounds, seed);
+        }
+
+        // "main seed <count>" tops the catalog up to count generated books for checks
+        if (!args.empty() && args[0] == "seed") {
+            if (args.size() != 2) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            return seedCatalog(db, std::stoi(args[1]));
+        }
+
+        // "main explain" prints the plans of the menu's statements and fails on lost indexes
+        if (!args.empty() && args[0] == "explain") {
+            if (args.size() != 1) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            return explainStatements(db);
+        }
+
+        // "main fuzzy-bench [queries]" times typo-tolerant searches over the catalog
+        if (!args.empty() && args[0] == "fuzzy-bench") {
+            if (args.size() > 2) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            int queries = args.size() == 2 ? std::stoi(args[1]) : FUZZY_BENCH_QUERIES;
+            if (queries < 1) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            return benchmarkFuzzySearch(db, queries);
+        }
+
+        // "main scan <term> [--threads <n>]" times a partitioned search and exits
+        if (!args.empty() && args[0] == "scan") {
+            if (args.size() != 2 && !(args.size() == 4 && args[2] == "--threads")) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            size_t threads = searchThreads;
+            if (args.size() == 4 && !parseThreadCount(args[3], threads)) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            return timePartitionedScan(db, args[1], threads) ? 0 : 1;
+        }
+
+        // "main view [title|author] [asc|desc] [--limit <k>]" prints the sorted catalog and exits
+        if (!args.empty() && args[0] == "view") {
+            std::string orderBy = "title";
+            bool descending = false;
+            int limit = 0;
+            for (size_t i = 1; i < args.size(); i++) {
+                if (args[i] == "title" || args[i] == "author") {
+                    orderBy = args[i];
+                } else if (args[i] == "asc" || args[i] == "desc") {
+                    descending = args[i] == "desc";
+                } else if (args[i] == "--limit" && i + 1 < args.size()) {
+                    limit = std::max(std::stoi(args[++i]), 0);
+                } else {
+                    printUsage(argv[0]);
+                    return 1;
+                }
+            }
+            listBooks(db, orderBy, descending, limit);
+            return 0;
+        }
+
+        // "main export <file> [order] [asc|desc] [--memory-mb <n>]" writes a sorted CSV export
+        if (!args.empty() && args[0] == "export") {
+            if (args.size() < 2) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            std::string orderName = "title";
+            bool descending = false;
+            size_t memoryMb = EXPORT_MEMORY_MB;
+            for (size_t i = 2; i < args.size(); i++) {
+                if (args[i] == "asc" || args[i] == "desc") {
+                    descending = args[i] == "desc";
+                } else if (args[i] == "--memory-mb" && i + 1 < args.size()) {
+                    memoryMb = std::max<size_t>(std::stoul(args[++i]), 1);
+                } else {
+                    orderName = args[i];
+                }
+            }
+            return exportBooks(db, args[1], orderName, descending, memoryMb << 20);
+        }
+
+        // "main bulk-delete|bulk-update <selection> ..." changes many books in chunks and exits
+        if (!args.empty() && (args[0] == "bulk-delete" || args[0] == "bulk-update")) {
+            return runBulkOperation(db, args, argv[0]);
+        }
+
+        // "main storage-stats" prints free page and fragmentation figures and exits
+        if (!args.empty() && args[0] == "storage-stats") {
+            showStorageStatistics(db);
+            return 0;
+        }
+
+        // "main vacuum-migrate" converts the database to incremental auto-vacuum and exits
+        if (!args.empty() && args[0] == "vacuum-migrate") {
+            return migrateToIncrementalVacuum(db);
+        }
+
+        // "main backup <file>" takes a single online backup and exits
+        if (!args.empty() && args[0] == "backup") {
+            if (args.size() != 2) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            return backupDatabase(db, args[1], nullptr) ? 0 : 1;
+        }
+
+        // "main check-backup [--writes <n>]" backs up while another connection writes and checks
+        // the copy
+        if (!args.empty() && args[0] == "check-backup") {
+            if (args.size() != 1 && !(args.size() == 3 && args[1] == "--writes")) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            int writes = args.size() == 3 ? std::stoi(args[2]) : BACKUP_CHECK_WRITES;
+            return checkConcurrentBackup(db, writes);
+        }
+
+#ifdef SQLITE_ENABLE_SESSION
+        // "main replicate <follower> [--follow]" applies the changeset log to a follower
+        if (!args.empty() && args[0] == "replicate") {
+            if (args.size() < 2 || args.size() > 3 || (args.size() == 3 && args[2] != "--follow")) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            return replicateFollower(db, args[1], args.size() == 3);
+        }
+#endif
+
+        // Options for the interactive session
+        BackupScheduler backupScheduler;
+        BackupScheduler snapshotScheduler;
+        MaintenanceScheduler maintenanceScheduler;
+        MetricsExporter metricsExporter;
+        for (size_t i = 0; i < args.size(); i++) {
+            if (args[i] == "--backup-every" && i + 2 < args.size()) {
+                std::chrono::seconds interval(std::stoi(args[i + 1]));
+                if (interval.count() <= 0) {
+                    std::cerr << "The backup interval must be at least one second.\n";
+                    return 1;
+                }
+                backupScheduler.start(db, args[i + 2], interval);
+                writeToLog(INFO,
+                           "Scheduled a backup to " + args[i + 2] + " every " + args[i + 1]
+                               + " seconds.");
+                i += 2;
+            } else if (args[i] == "--in-memory" || args[i] == "--uring-vfs") {
+                // Already applied when the database was opened
+            } else if (args[i] == "--snapshot-every" && i + 1 < args.size() && inMemory) {
+                if (std::stoi(args[i + 1]) <= 0) {
+                    std::cerr << "The snapshot interval must be at least one second.\n";
+                    return 1;
+                }
+                snapshotScheduler.start(
+                    DATABASE_PATH, std::chrono::seconds(std::stoi(args[i + 1])),
+                    [&dbConnection] { return dbConnection.saveChanges(BACKUP_PAGES_PER_STEP); });
+                writeToLog(INFO, std::string("Scheduled a snapshot to ") + DATABASE_PATH + " every "
+                                     + args[i + 1] + " seconds.");
+                i++;
+            } else if (args[i] == "--maintain-every" && i + 1 < args.size() && inMemory) {
+                // The maintenance job works on its own connection to the file
+                writeToLog(WARNING, "Maintenance is skipped for an in-memory database.");
+                i++;
+            } else if (args[i] == "--maintain-every" && i + 1 < args.size()) {
+                maintenanceScheduler.start(sqlite3_db_filename(db, "main"),
+                                           std::chrono::seconds(std::stoi(args[i + 1])));
+                writeToLog(INFO, "Scheduled maintenance every " + args[i + 1] + " seconds.");
+                i++;
+            } else if (args[i] == "--metrics") {
+                metricsExporter.start(db, METRICS_PATH);
+                writeToLog(INFO,
+                           std::string("Writing metrics to ") + METRICS_PATH + " on SIGUSR1.");
+            } else if (args[i] == "--binary-log") {
+                std::lock_guard<std::mutex> lock(logMutex);
+                if (!binaryLog.open(BINARY_LOG_PATH)) {
+                    std::cerr << "Cannot open " << BINARY_LOG_PATH << ".\n";
+                    return 1;
+                }
+            } else if (args[i] == "--search-threads" && i + 1 < args.size()) {
+                if (!parseThreadCount(args[++i], searchThreads)) {
+                    printUsage(argv[0]);
+                    return 1;
+                }
+            } else if (args[i] == "--capture-changes") {
+                if (!changeCapture.open(db, CHANGE_LOG_PATH)) {
+                    return 1;
+                }
+                writeToLog(INFO, std::string("Capturing changes to ") + CHANGE_LOG_PATH + ".");
+#ifdef SQLITE_ENABLE_SESSION
+            } else if (args[i] == "--publish-changesets") {
+                if (!changesetPublisher.open(db, CHANGESET_LOG_PATH)) {
+                    handleSqliteError(db, "start replication session");
+                    return 1;
+                }
+                writeToLog(INFO,
+                           std::string("Publishing changesets to ") + CHANGESET_LOG_PATH + ".");
+#endif
+            } else {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+
+        if (!resourceAccounting.attach(db)) {
+            handleSqliteError(db, "start resource accounting");
+        }
+
+        while (true) {
+            displayMenu();
+
+            int choice = getValidIntegerInput();
+
+            switch (choice) {
+            case MENU_ADD_BOOK:
+                writeToLog(INFO, "User selected to add a book.");
+                addBook(db);
+                break;
+            case MENU_VIEW_BOOKS:
+                writeToLog(INFO, "User selected to view books.");
+                viewBooks(db);
+                break;
+            case MENU_DELETE_BOOK:
+                writeToLog(INFO, "User selected to delete a book.");
+                deleteBook(db);
+                break;
+            case MENU_SEARCH_BOOK:
+                writeToLog(INFO, "User selected to search for a book.");
+                searchBooks(db);
+                break;
+            case MENU_UPDATE_BOOK:
+                writeToLog(INFO, "User selected to update a book.");
+                updateBook(db);
+                break;
+            case MENU_CATALOG_STATS:
+                writeToLog(INFO, "User selected to view catalog statistics.");
+                showCatalogStatistics(db);
+                break;
+            case MENU_BACKUP:
+                writeToLog(INFO, "User selected to back up the database.");
+                backupBooks(db);
+                break;
+            case MENU_TOP_AUTHORS:
+                writeToLog(INFO, "User selected to list the top authors.");
+                listTopAuthors(db, TOP_AUTHORS_LIMIT);
+                break;
+            case MENU_QUIT: {
+                writeToLog(INFO, "User selected to quit.");
+                reportResourceUsage();
+                // The final snapshot must not race a scheduled one over books.db.partial
+                backupScheduler.stop();
+                snapshotScheduler.stop();
+                maintenanceScheduler.stop();
+                metricsExporter.stop();
+                dbConnection.saveChanges();
+                // Close the log file
+                closeLog();
+                // Close the database and exit
+                return 0;
+            }
+            default:
+                std::cout << "Invalid choice. Please try again.\n";
+                break;
+            }
+        }
+        reportResourceUsage();
+        // Close the log file
+        closeLog();
+
+        // Close the database and exit
+        return 0;
+    } catch (const std::invalid_argument&) {
+        // std::stoi and friends reject a numeric argument that is not a number
+        std::cerr << "Expected a number in the arguments.\n";
+        printUsage(argv[0]);
+        reportResourceUsage();
+        return 1;
+    } catch (const std::out_of_range&) {
+        std::cerr << "A numeric argument is out of range.\n";
+        printUsage(argv[0]);
+        reportResourceUsage();
+        return 1;
+    } catch (const std::exception& e) {
+        std::cerr << "An error occurred: " << e.what() << "\n";
+        reportResourceUsage();
+        // Close the log file
+        closeLog();
+        return 1;
+    }
+}
+
+// Function to display the menu
+void displayMenu() {
+    std::cout << "\n*** Book Management System ***\n";
+    std::cout << "1. Add a book\n";
+    std::cout << "2. View all books\n";
+    std::cout << "3. Delete a book\n";
+    std::cout << "4. Search a book\n";
+    std::cout << "5. Update a book\n";
+    std::cout << "6. Catalog statistics\n";
+    std::cout << "7. Back up the database\n";
+    std::cout << "8. Top authors\n";
+    std::cout << "9. Quit\n";
+    std::cout << "Enter your choice: ";
+}
+
+// Function to add a book to the database
+void addBook(sqlite3* db) {
+    ResourceScope resources(db, METRIC_ADD);
+    while (true) {
+        std::string title, author;
+        std::cout << "Enter the title of the book: ";
+        std::cin.ignore();
+        std::getline(std::cin, title);
+
+        // Check if a book with the same title already exists
+        if (titleExists(db, title)) {
+            std::cout << "A book with the same title already exists in the database.\n";
+            // Ask if the user wants to add another book
+            char tryAgain;
+            std::cout << "\nDo you want to try again? (y/n): ";
+            std::cin >> tryAgain;
+            if (tryAgain != 'y' && tryAgain != 'Y') {
+                break;  // Return to the main menu
+            }
+            continue;
+        }
+
+        // If no duplicate title, continue with adding the book
+        std::cout << "Enter the author of the book: ";
+        std::getline(std::cin, author);
+
+        if (insertBook(db, title, author) != 0) {
+            std::cout << "Book added successfully.\n";
+            return;
+        }
+    }
+}
+
+// Function to insert a book, publish the change and index it, returning its ID or 0 on failure
+int insertBook(sqlite3* db, const std::string& title, const std::string& author) {
+    OperationTimer timer(METRIC_ADD);
+    // Use parameterized query to insert the book
+    sqlite3_stmt* stmt;
+
+    int rc = sqlite3_prepare_v2(db, INSERT_BOOK_SQL, -1, &stmt, nullptr);
+    if (rc != SQLITE_OK) {
+        handleSqliteError(db, "prepare statement");
+        return 0;
+    }
+
+    sqlite3_bind_text(stmt, 1, title.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, author.c_str(), -1, SQLITE_STATIC);
+
+    rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        handleSqliteError(db, "execute statement");
+        return 0;
+    }
+
+    int bookId = static_cast<int>(sqlite3_last_insert_rowid(db));
+    publishChanges(db);
+    indexBook(bookId, title, author);
+    metrics.addRowsWritten(1);
+    timer.succeeded();
+    return bookId;
+}
+
+// Function to check whether a title is taken, consulting the Bloom filter before the index
+bool titleExists(sqlite3* db, const std::string& title) {
+    if ((!titleFilter.isBuilt() || titleFilter.isFull()) && !titleFilter.build(db)) {
+        handleSqliteError(db, "build title filter");
+    }
+    if (titleFilter.isBuilt() && !titleFilter.mayContain(title)) {
+        metrics.cacheHit(CACHE_TITLE_FILTER);
+        return false;
+    }
+    metrics.cacheMiss(CACHE_TITLE_FILTER);
+
+    sqlite3_stmt* checkStmt;
+    int rc = sqlite3_prepare_v2(db, TITLE_EXISTS_SQL, -1, &checkStmt, nullptr);
+    if (rc != SQLITE_OK) {
+        handleSqliteError(db, "prepare statement");
+        return false;
+    }
+
+    sqlite3_bind_text(checkStmt, 1, title.c_str(), -1, SQLITE_STATIC);
+    rc = sqlite3_step(checkStmt);
+    sqlite3_finalize(checkStmt);
+
+    if (rc != SQLITE_ROW && titleFilter.isBuilt()) {
+        titleFilter.recordFalsePositive();
+    }
+    return rc == SQLITE_ROW;
+}
+
+// Function to view books with sorting
+void viewBooks(sqlite3* db) {
+    ResourceScope resources(db, METRIC_VIEW);
+    // Prompt the user for sorting criteria
+    std::cout << "Select sorting criterion:\n";
+    std::cout << "1. Sort by Title\n";
+    std::cout << "2. Sort by Author\n";
+    std::cout << "Enter your choice: ";
+
+    int sortChoice = getValidIntegerInput();
+
+    std::string orderBy;
+
+    switch (sortChoice) {
+    case 1:
+        orderBy = "title";
+        break;
+    case 2:
+        orderBy = "author";
+        break;
+    default:
+        std::cout << "Invalid choice. Books will not be sorted.\n";
+        break;
+    }
+
+    if (!orderBy.empty()) {
+        // Prompt the user for sorting order
+        std::cout << "Select sorting order:\n";
+        std::cout << "1. Ascending\n";
+        std::cout << "2. Descending\n";
+        std::cout << "Enter your choice: ";
+
+        int sortOrderChoice = getValidIntegerInput();
+
+        std::string sortOrder
+            = (sortOrderChoice == 2) ? "DESC" : "ASC";  // Default to ascending for other choices
+
+        // View all books in the database with the selected sorting criteria and order
+        listBooks(db, orderBy, sortOrder == "DESC", 0);
+    }
+}
+
+// Function to write the catalog to a CSV file in an order SQLite has no index for. One rowid
+// scan feeds an external merge sort, instead of SQLite building a temporary B-tree of the table.
+int exportBooks(sqlite3* db,
+                const std::string& path,
+                const std::string& orderName,
+                bool descending,
+                size_t memoryBudget) {
+    OperationTimer timer(METRIC_EXPORT);
+    static const std::unordered_map<std::string, ExportOrder> orders = {
+        {"title", EXPORT_BY_TITLE},
+        {"author", EXPORT_BY_AUTHOR},
+        {"title-nocase", EXPORT_BY_TITLE_NOCASE},
+        {"author-nocase", EXPORT_BY_AUTHOR_NOCASE},
+        {"title-length", EXPORT_BY_TITLE_LENGTH},
+    };
+    auto found = orders.find(orderName);
+    if (found == orders.end()) {
+        std::cerr << "Unknown export order: " << orderName << "\n";
+        return 1;
+    }
+    ExportOrder order = found->second;
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Cannot open " << path << " for writing.\n";
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    ExternalSorter sorter(memoryBudget, descending);
+    const char* selectSQL = "SELECT id, title, author FROM books;";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, selectSQL, -1, &stmt, nullptr) != SQLITE_OK) {
+        handleSqliteError(db, "prepare statement");
+        return 1;
+    }
+
+    // Keys match SQLite's BINARY collation, ASCII-only lower() and character-counting length()
+    std::string key;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const unsigned char* title = sqlite3_column_text(stmt, 1);
+        const unsigned char* author = sqlite3_column_text(stmt, 2);
+        Book book{sqlite3_column_int(stmt, 0), title ? reinterpret_cast<const char*>(title) : "",
+                  author ? reinterpret_cast<const char*>(author) : ""};
+
+        switch (order) {
+        case EXPORT_BY_TITLE:
+        case EXPORT_BY_TITLE_NOCASE:
+            key = book.title;
+            break;
+        case EXPORT_BY_AUTHOR:
+        case EXPORT_BY_AUTHOR_NOCASE:
+            key = book.author;
+            break;
+        case EXPORT_BY_TITLE_LENGTH: {
+            uint64_t characters = std::count_if(book.title.begin(), book.title.end(),
+                                                [](char c) { return (c & 0xC0) != 0x80; });
+            key.clear();
+            for (int shift = 56; shift >= 0; shift -= 8) {
+                key.push_back(static_cast<char>(characters >> shift));
+            }
+            break;
+        }
+        }
+        if (order == EXPORT_BY_TITLE_NOCASE || order == EXPORT_BY_AUTHOR_NOCASE) {
+            for (char& c : key) {
+                c = static_cast<char>(foldCase(static_cast<unsigned char>(c)));
+            }
+        }
+        if (!sorter.add(key, book)) {
+            break;
+        }
+    }
+    if (rc != SQLITE_DONE && rc != SQLITE_ROW) {
+        handleSqliteError(db, "execute statement");
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        return 1;
+    }
+
+    auto csvField = [&out](const std::string& value) {
+        if (value.find_first_of(",\"\r\n") == std::string::npos) {
+            out << value;
+            return;
+        }
+        out << '"';
+        for (char c : value) {
+            out << c;
+            if (c == '"') {
+                out << '"';
+            }
+        }
+        out << '"';
+    };
+    size_t rows = 0;
+    out << "id,title,author\n";
+    bool sorted = sorter.finish([&](const Book& book) {
+        out << book.id << ',';
+        csvField(book.title);
+        out << ',';
+        csvField(book.author);
+        out << '\n';
+        rows++;
+    });
+    out.close();
+    if (!sorted || !out) {
+        std::cerr << "Export to " << path << " failed.\n";
+        return 1;
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    logEvent(INFO, LOG_EVENT_EXPORT,
+             {rows, orderName, path, elapsed.count(), sorter.runCount(),
+              sorter.spilledBytes() >> 20});
+    std::cout << "Exported " << rows << " books to " << path << ".\n";
+    metrics.addRowsRead(rows);
+    timer.succeeded();
+    return 0;
+}
+
+// Function to check whether an index on the books table starts with the given column
+bool hasLeadingIndex(sqlite3* db, const std::string& column) {
+    const char* indexSQL
+        = "SELECT 1 FROM pragma_index_list('books') AS list, pragma_index_info(list.name) AS info "
+          "WHERE list.partial = 0 AND info.seqno = 0 AND info.name = ?;";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, indexSQL, -1, &stmt, nullptr) != SQLITE_OK) {
+        handleSqliteError(db, "prepare statement");
+        return false;
+    }
+    sqlite3_bind_text(stmt, 1, column.c_str(), -1, SQLITE_STATIC);
+    bool found = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+// Function to list books sorted by title or author, stopping after limit rows when limit > 0.
+// With an index on the sort column SQLite walks the first rows in index order; without one, a
+// bounded heap keeps the best limit rows of one scan, so the table is never sorted whole. Rows
+// are printed a page at a time and the first page is flushed as soon as it is complete.
+void listBooks(sqlite3* db, const std::string& orderBy, bool descending, int limit) {
+    OperationTimer timer(METRIC_VIEW);
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration firstRow{};
+    size_t printed = 0;
+    std::string page;
+
+    printBookTableHeader();
+    std::cout << std::flush;
+    auto emit = [&](const Book& book) {
+        if (printed++ == 0) {
+            firstRow = std::chrono::steady_clock::now() - start;
+        }
+        appendBookRow(page, book);
+        if (printed % VIEW_PAGE_ROWS == 0) {
+            std::cout << page << std::flush;
+            page.clear();
+        }
+    };
+
+    bool useHeap = limit > 0 && !hasLeadingIndex(db, orderBy);
+    std::string selectSQL = listBooksSQL(orderBy, descending, limit, useHeap);
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, selectSQL.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        handleSqliteError(db, "prepare statement");
+        return;
+    }
+    int keyColumn = orderBy == "author" ? 2 : 1;
+    auto text = [stmt](int column) {
+        const unsigned char* value = sqlite3_column_text(stmt, column);
+        return std::string_view(value ? reinterpret_cast<const char*>(value) : "");
+    };
+
+    // Heap order puts the row that would be listed last on top, ready to be evicted
+    auto listedBefore = [keyColumn, descending](const Book& a, const Book& b) {
+        const std::string& keyA = keyColumn == 2 ? a.author : a.title;
+        const std::string& keyB = keyColumn == 2 ? b.author : b.title;
+        int order = keyA.compare(keyB);
+        if (order == 0) {
+            return a.id < b.id;
+        }
+        return descending ? order > 0 : order < 0;
+    };
+    std::vector<Book> heap;
+
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if (!useHeap) {
+            emit({sqlite3_column_int(stmt, 0), std::string(text(1)), std::string(text(2))});
+            continue;
+        }
+        int id = sqlite3_column_int(stmt, 0);
+        if (heap.size() == static_cast<size_t>(limit)) {
+            // Most rows lose against the current last row and are dropped without copying
+            const Book& last = heap.front();
+            int order = text(keyColumn).compare(keyColumn == 2 ? last.author : last.title);
+            bool before = order == 0 ? id < last.id : (descending ? order > 0 : order < 0);
+            if (!before) {
+                continue;
+            }
+            std::pop_heap(heap.begin(), heap.end(), listedBefore);
+            heap.pop_back();
+        }
+        heap.push_back({id, std::string(text(1)), std::string(text(2))});
+        std::push_heap(heap.begin(), heap.end(), listedBefore);
+    }
+    if (rc != SQLITE_DONE) {
+        handleSqliteError(db, "execute statement");
+    } else {
+        timer.succeeded();
+    }
+    sqlite3_finalize(stmt);
+
+    std::sort_heap(heap.begin(), heap.end(), listedBefore);
+    for (const Book& book : heap) {
+        emit(book);
+    }
+    std::cout << page;
+
+    metrics.addRowsRead(printed);
+    auto total = std::chrono::steady_clock::now() - start;
+    logEvent(DEBUG, LOG_EVENT_LISTING,
+             {printed, orderBy, useHeap ? "with a bounded heap" : "in SQLite order",
+              std::chrono::duration_cast<std::chrono::microseconds>(firstRow).count(),
+              std::chrono::duration_cast<std::chrono::microseconds>(total).count()});
+}
+
+// Function to build the statement of a listing; with a bounded heap SQLite only feeds the rows
+std::string listBooksSQL(const std::string& orderBy, bool descending, int limit, bool useHeap) {
+    std::string selectSQL = "SELECT id, title, author FROM books";
+    if (!useHeap) {
+        selectSQL += " ORDER BY " + orderBy + (descending ? " DESC" : " ASC");
+        // Authors repeat, so ties go to the lower id as in the heap's order; titles are UNIQUE
+        // and a tiebreak there would turn the descending index walk into a sort
+        if (orderBy != "title") {
+            selectSQL += ", id";
+        }
+        if (limit > 0) {
+            selectSQL += " LIMIT " + std::to_string(limit);
+        }
+    }
+    return selectSQL + ";";
+}
+
+// Function to print the column header shared by the book listings
+void printBookTableHeader() {
+    std::cout << std::left << std::setw(8) << "ID";
+    std::cout << " | ";
+    std::cout << std::left << std::setw(24) << "Title";
+    std::cout << " | ";
+    std::cout << std::left << std::setw(16) << "Author"
+              << "\n";
+
+    std::cout << std::setfill('=') << std::setw(8) << ""
+              << "=";
+    std::cout << std::setw(26) << ""
+              << "=";
+    std::cout << std::setw(18) << ""
+              << "\n";
+    std::cout << std::setfill(' ');
+}
+
+// Function to search for books by title or author with parameterized query
+void searchBooks(sqlite3* db) {
+    ResourceScope resources(db, METRIC_SEARCH);
+    while (true) {
+        std::cout << "Select search mode:\n";
+        std::cout << "1. Contains (title or author substring)\n";
+        std::cout << "2. Fuzzy match (tolerates typos)\n";
+        std::cout << "3. Autocomplete title or author\n";
+        std::cout << "Enter your choice: ";
+
+        int searchMode = getValidIntegerInput();
+
+        int maxDistance = 0;
+        if (searchMode == SEARCH_MODE_FUZZY) {
+            std::cout << "Enter the maximum number of typos to tolerate (1-" << MAX_FUZZY_DISTANCE
+                      << "): ";
+            maxDistance = std::clamp(getValidIntegerInput(), 1, MAX_FUZZY_DISTANCE);
+        }
+
+        std::string searchTerm;
+        std::cout << "Enter search term (title or author): ";
+        std::cin.ignore();
+        std::getline(std::cin, searchTerm);
+
+        if (searchMode == SEARCH_MODE_FUZZY) {
+            fuzzySearchBooks(db, searchTerm, maxDistance);
+        } else if (searchMode == SEARCH_MODE_AUTOCOMPLETE) {
+            autocompleteBooks(db, searchTerm);
+        } else {
+            likeSearchBooks(db, searchTerm);
+        }
+
+        // Ask if the user wants to search again
+        char tryAgain;
+        std::cout << "\nDo you want to search again? (y/n): ";
+        std::cin >> tryAgain;
+        if (tryAgain != 'y' && tryAgain != 'Y') {
+            break;  // Return to the main menu
+        }
+    }
+}
+
+// Function to list books whose title or author contains the search term
+void likeSearchBooks(sqlite3* db, const std::string& searchTerm) {
+    OperationTimer timer(METRIC_SEARCH);
+    // Plain terms are scanned in the in-memory snapshot; LIKE wildcards still need SQLite
+    if (searchTerm.find_first_of("%_") == std::string::npos) {
+        if (snapshotSearchBooks(db, searchTerm)) {
+            timer.succeeded();
+        }
+        return;
+    }
+
+    // Large tables are split into rowid ranges scanned by several threads
+    std::vector<Book> books;
+    if (searchThreads > 1
+        && partitionedScanner.search(db, "%" + searchTerm + "%", searchThreads, books)) {
+        std::cout << "Search Results:\n";
+        printBookTableHeader();
+        for (const Book& book : books) {
+            printBookRow(book);
+        }
+        metrics.addRowsRead(books.size());
+        timer.succeeded();
+        return;
+    }
+
+    // Display header, then print results row by row as SQLite produces them
+    std::cout << "Search Results:\n";
+    printBookTableHeader();
+    size_t found = 0;
+    bool ok = findBooks(db, "%" + searchTerm + "%", 0, -1, [&found](const Book& book) {
+        printBookRow(book);
+        found++;
+    });
+    metrics.addRowsRead(found);
+    if (ok) {
+        timer.succeeded();
+    }
+}
+
+// Function to visit, in ID order, the books after afterId whose title or author matches a LIKE
+// pattern, stopping after limit rows (-1 for no limit)
+bool findBooks(sqlite3* db,
+               const std::string& pattern,
+               int afterId,
+               int limit,
+               const std::function<void(const Book&)>& visit) {
+    // Search for books with a parameterized query
+    sqlite3_stmt* stmt;
+
+    int rc = sqlite3_prepare_v2(db, FIND_BOOKS_SQL, -1, &stmt, nullptr);
+    if (rc != SQLITE_OK) {
+        handleSqliteError(db, "prepare statement");
+        return false;
+    }
+
+    sqlite3_bind_text(stmt, 1, pattern.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, afterId);
+    sqlite3_bind_int(stmt, 3, limit);
+
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const unsigned char* title = sqlite3_column_text(stmt, 1);
+        const unsigned char* author = sqlite3_column_text(stmt, 2);
+        visit({sqlite3_column_int(stmt, 0), title ? reinterpret_cast<const char*>(title) : "",
+               author ? reinterpret_cast<const char*>(author) : ""});
+    }
+
+    if (rc != SQLITE_DONE) {
+        handleSqliteError(db, "execute statement");
+    }
+
+    sqlite3_finalize(stmt);
+    return rc == SQLITE_DONE;
+}
+
+// Function to list books containing the search term using the in-memory text snapshot
+bool snapshotSearchBooks(sqlite3* db, const std::string& searchTerm) {
+    if (textSnapshot.isBuilt()) {
+        metrics.cacheHit(CACHE_TEXT_SNAPSHOT);
+    } else {
+        metrics.cacheMiss(CACHE_TEXT_SNAPSHOT);
+        writeToLog(INFO, "Building text snapshot for substring search.");
+        if (!textSnapshot.build(db)) {
+            handleSqliteError(db, "build text snapshot");
+            return false;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Book> books = textSnapshot.find(searchTerm);
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start);
+    logEvent(DEBUG, LOG_EVENT_SNAPSHOT_SCAN,
+             {textSnapshot.bytes(), elapsed.count() / 1000,
+              textSnapshot.bytes() / std::max<double>(elapsed.count(), 1)});
+
+    std::cout << "Search Results:\n";
+    printBookTableHeader();
+    for (const Book& book : books) {
+        printBookRow(book);
+    }
+    metrics.addRowsRead(books.size());
+    return true;
+}
+
+// Function to run a partitioned search for the term and report how long it took
+bool timePartitionedScan(sqlite3* db, const std::string& searchTerm, size_t threads) {
+    std::vector<Book> books;
+    auto start = std::chrono::steady_clock::now();
+    if (!partitionedScanner.search(db, "%" + searchTerm + "%", threads, books)) {
+        std::cerr << "Partitioned scan failed." << std::endl;
+        return false;
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    std::cout << books.size() << " books match \"" << searchTerm << "\" (" << threads
+              << " threads, " << std::fixed << std::setprecision(1) << elapsed.count() / 1000.0
+              << " ms)\n";
+    return true;
+}
+
+// Function to print one book under printBookTableHeader
+void printBookRow(const Book& book) {
+    std::string row;
+    appendBookRow(row, book);
+    std::cout << row;
+}
+
+// Function to format one book the way printBookRow prints it
+void appendBookRow(std::string& out, const Book& book) {
+    auto appendPadded = [&out](const std::string& value, size_t width) {
+        out += value;
+        if (value.size() < width) {
+            out.append(width - value.size(), ' ');
+        }
+    };
+    appendPadded(std::to_string(book.id), 8);
+    out += " | ";
+    appendPadded(book.title, 24);
+    out += " | ";
+    appendPadded(book.author, 16);
+    out += '\n';
+}
+
+// Function to list books within a bounded edit distance of the search term
+void fuzzySearchBooks(sqlite3* db, const std::string& searchTerm, int maxDistance) {
+    OperationTimer timer(METRIC_SEARCH);
+    if (searchTerm.size() < FUZZY_MIN_TERM) {
+        std::cout << "Enter at least " << FUZZY_MIN_TERM << " characters for a fuzzy search, or "
+                  << "use Contains for shorter terms.\n";
+        return;
+    }
+    if (fuzzyIndex.isBuilt()) {
+        metrics.cacheHit(CACHE_FUZZY_INDEX);
+    } else {
+        metrics.cacheMiss(CACHE_FUZZY_INDEX);
+        writeToLog(INFO, "Building fuzzy search index.");
+        if (!fuzzyIndex.build(db)) {
+            handleSqliteError(db, "build fuzzy index");
+            return;
+        }
+    }
+
+    std::vector<FuzzyMatch> matches = fuzzyIndex.search(searchTerm, maxDistance);
+
+    std::cout << "Search Results:\n";
+    printBookTableHeader();
+    for (const FuzzyMatch& match : matches) {
+        std::cout << std::left << std::setw(8) << match.id;
+        std::cout << " | ";
+        std::cout << std::left << std::setw(24) << match.title;
+        std::cout << " | ";
+        std::cout << std::left << std::setw(16) << match.author;
+        std::cout << " (" << match.distance << (match.distance == 1 ? " typo" : " typos") << ")\n";
+    }
+    metrics.addRowsRead(matches.size());
+    timer.succeeded();
+}
+
+// Function to time fuzzy searches for terms cut from random books with typos added, reporting
+// latency percentiles over all terms and over the short ones, which the bigram filter prunes least
+int benchmarkFuzzySearch(sqlite3* db, int queries) {
+    auto start = std::chrono::steady_clock::now();
+    FuzzyIndex index;
+    if (!index.build(db)) {
+        handleSqliteError(db, "build fuzzy index");
+        return 1;
+    }
+    auto built = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+
+    // Books are sampled at seeded random ids, so runs over the same catalog time the same terms
+    std::mt19937 random(FUZZY_BENCH_SEED);
+    sqlite3_int64 maxId = 0;
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT max(id) FROM books;", -1, &stmt, nullptr) != SQLITE_OK) {
+        handleSqliteError(db, "prepare statement");
+        return 1;
+    }
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        maxId = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    const char* sampleSQL = "SELECT title, author FROM books WHERE id >= ? ORDER BY id LIMIT 1;";
+    if (sqlite3_prepare_v2(db, sampleSQL, -1, &stmt, nullptr) != SQLITE_OK) {
+        handleSqliteError(db, "prepare statement");
+        return 1;
+    }
+    std::vector<std::string> fields;
+    for (int query = 0; maxId > 0 && query < queries; query++) {
+        sqlite3_bind_int64(stmt, 1, 1 + static_cast<sqlite3_int64>(random() % maxId));
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            for (int column = 0; column < 2; column++) {
+                const unsigned char* text = sqlite3_column_text(stmt, column);
+                if (text && std::strlen(reinterpret_cast<const char*>(text)) >= FUZZY_MIN_TERM) {
+                    fields.emplace_back(reinterpret_cast<const char*>(text));
+                }
+            }
+        }
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+    if (fields.empty()) {
+        std::cerr << "The catalog has no title or author to search for.\n";
+        return 1;
+    }
+
+    // A term is a random slice of a title or author with one to MAX_FUZZY_DISTANCE random
+    // substitutions, deletions or insertions, searched with that many typos allowed
+    std::vector<double> all, shortTerms;
+    size_t matched = 0;
+    for (int query = 0; query < queries; query++) {
+        const std::string& field = fields[random() % fields.size()];
+        size_t longest = std::min(field.size(), FUZZY_BENCH_MAX_TERM);
+        size_t length = FUZZY_MIN_TERM + random() % (longest - FUZZY_MIN_TERM + 1);
+        std::string term = field.substr(random() % (field.size() - length + 1), length);
+        int typos = 1 + static_cast<int>(random() % std::min<size_t>(MAX_FUZZY_DISTANCE,
+                                                                      length / 3));
+        for (int typo = 0; typo < typos; typo++) {
+            size_t at = random() % term.size();
+            char letter = static_cast<char>('a' + random() % 26);
+            switch (random() % 3) {
+            case 0:
+                term[at] = letter;
+                break;
+            case 1:
+                if (term.size() > FUZZY_MIN_TERM) {
+                    term.erase(at, 1);
+                } else {
+                    term[at] = letter;
+                }
+                break;
+            default:
+                term.insert(at, 1, letter);
+                break;
+            }
+        }
+
+        auto queryStart = std::chrono::steady_clock::now();
+        matched += index.search(term, typos).size();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()
+                                                              - queryStart)
+                        .count();
+        all.push_back(ms);
+        if (length <= 5) {
+            shortTerms.push_back(ms);
+        }
+    }
+
+    auto report = [](const char* label, std::vector<double>& times) {
+        if (times.empty()) {
+            return;
+        }
+        std::sort(times.begin(), times.end());
+        std::cout << std::left << std::setw(22) << label << std::right << std::setw(6)
+                  << times.size() << " queries  p50 " << std::setw(7) << times[times.size() / 2]
+                  << " ms  p99 " << std::setw(7) << times[times.size() * 99 / 100]
+                  << " ms  max " << std::setw(7) << times.back() << " ms\n";
+    };
+    std::cout << std::fixed << std::setprecision(2) << "Index built in " << built.count()
+              << " ms; " << matched / queries << " matches per query on average\n";
+    report("all terms", all);
+    report("terms of 3-5 chars", shortTerms);
+    return 0;
+}
+
+// Function to suggest the most popular titles and authors starting with a prefix
+void autocompleteBooks(sqlite3* db, const std::string& prefix) {
+    OperationTimer timer(METRIC_SEARCH);
+    if (prefixIndex.isBuilt()) {
+        metrics.cacheHit(CACHE_PREFIX_INDEX);
+    } else {
+        metrics.cacheMiss(CACHE_PREFIX_INDEX);
+        auto start = std::chrono::steady_clock::now();
+        if (!prefixIndex.build(db)) {
+            handleSqliteError(db, "build autocomplete index");
+            return;
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start);
+        logEvent(INFO, LOG_EVENT_AUTOCOMPLETE_BUILT,
+                 {prefixIndex.size(), prefixIndex.memoryUsage() / 1024, elapsed.count()});
+    }
+
+    // Replay the prefix one keystroke at a time, as a type-ahead client would
+    std::vector<Completion> completions;
+    std::chrono::nanoseconds total(0), slowest(0);
+    for (size_t length = 1; length <= prefix.size(); length++) {
+        auto start = std::chrono::steady_clock::now();
+        completions = prefixIndex.complete(prefix.substr(0, length), AUTOCOMPLETE_RESULTS);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        total += elapsed;
+        slowest = std::max(slowest, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed));
+    }
+
+    std::cout << "Suggestions:\n";
+    for (const Completion& completion : completions) {
+        std::cout << std::left << std::setw(40) << completion.text << " | "
+                  << (completion.isAuthor ? "author" : "title ") << " | " << completion.books
+                  << (completion.books == 1 ? " book" : " books") << "\n";
+    }
+    if (!prefix.empty()) {
+        std::cout << "Lookup time per keystroke: " << total.count() / prefix.size() / 1000.0
+                  << " us average, " << slowest.count() / 1000.0 << " us slowest\n";
+    }
+    timer.succeeded();
+}
+
+// Function to delete a book from the database
+void deleteBook(sqlite3* db) {
+    ResourceScope resources(db, METRIC_DELETE);
+    std::cout << "Enter the ID of the book you want to delete: ";
+    int bookId = getValidIntegerInput();
+
+    // Retrieve the title and author information based on the book ID
+    Book book{bookId, "", ""};
+    fetchBook(db, bookId, book);
+
+    // Ask for confirmation before deleting the book
+    std::cout << "You are about to delete the following book:\n";
+    std::cout << "Title: " << book.title << "\n";
+    std::cout << "Author: " << book.author << "\n";
+
+    char confirm;
+    std::cout << "Are you sure you want to delete this book? (y/n): ";
+    std::cin >> confirm;
+
+    if (confirm == 'y' || confirm == 'Y') {
+        if (removeBook(db, book)) {
+            std::cout << "Book deleted successfully.\n";
+        }
+    } else {
+        std::cout << "Deletion canceled.\n";
+    }
+}
+
+// Function to read a book by ID, returning false when there is no such book
+bool fetchBook(sqlite3* db, int bookId, Book& book) {
+    sqlite3_stmt* selectStmt;
+
+    int rc = sqlite3_prepare_v2(db, FETCH_BOOK_SQL, -1, &selectStmt, nullptr);
+    if (rc != SQLITE_OK) {
+        handleSqliteError(db, "prepare statement");
+        return false;
+    }
+
+    sqlite3_bind_int(selectStmt, 1, bookId);
+
+    rc = sqlite3_step(selectStmt);
+    if (rc == SQLITE_ROW) {
+        const unsigned char* title = sqlite3_column_text(selectStmt, 0);
+        const unsigned char* author = sqlite3_column_text(selectStmt, 1);
+        book.id = bookId;
+        book.title = title ? reinterpret_cast<const char*>(title) : "";
+        book.author = author ? reinterpret_cast<const char*>(author) : "";
+        metrics.addRowsRead(1);
+    }
+
+    sqlite3_finalize(selectStmt);
+    return rc == SQLITE_ROW;
+}
+
+// Function to delete a book, publish the change and drop it from the in-memory indexes
+bool removeBook(sqlite3* db, const Book& book) {
+    OperationTimer timer(METRIC_DELETE);
+    // Use parameterized query to delete the book
+    sqlite3_stmt* deleteStmt;
+
+    int rc = sqlite3_prepare_v2(db, DELETE_BOOK_SQL, -1, &deleteStmt, nullptr);
+    if (rc != SQLITE_OK) {
+        handleSqliteError(db, "prepare statement");
+        return false;
+    }
+
+    sqlite3_bind_int(deleteStmt, 1, book.id);
+
+    rc = sqlite3_step(deleteStmt);
+    sqlite3_finalize(deleteStmt);
+    if (rc != SQLITE_DONE) {
+        handleSqliteError(db, "execute statement");
+        return false;
+    }
+
+    metrics.addRowsWritten(sqlite3_changes(db));
+    publishChanges(db);
+    unindexBook(book.id, book.title, book.author);
+    timer.succeeded();
+    return true;
+}
+
+// Function to update a book in the database
+void updateBook(sqlite3* db) {
+    ResourceScope resources(db, METRIC_UPDATE);
+    std::cout << "Enter the ID of the book you want to update: ";
+    int bookId = getValidIntegerInput();
+
+    // Check if the book with the specified ID exists
+    if (!checkIfExists(db, bookId)) {
+        std::cout << "Book with ID " << bookId << " does not exist in the database.\n";
+        return;
+    }
+
+    // Retrieve the current title and author information based on the book ID
+    Book current{bookId, "", ""};
+    if (!fetchBook(db, bookId, current)) {
+        return;
+    }
+    const std::string& currentTitle = current.title;
+    const std::string& currentAuthor = current.author;
+
+    std::string newTitle, newAuthor;
+    std::cout
+        << "Enter the new title of the book (or press Enter to keep it unchanged, current title: "
+        << currentTitle << "): ";
+    std::cin.ignore();
+    std::getline(std::cin, newTitle);
+
+    if (newTitle.empty()) {
+        newTitle = currentTitle;  // Keep the current title if the user presses Enter
+    }
+
+    std::cout
+        << "Enter the new author of the book (or press Enter to keep it unchanged, current author: "
+        << currentAuthor << "): ";
+    std::getline(std::cin, newAuthor);
+
+    if (newAuthor.empty()) {
+        newAuthor = currentAuthor;  // Keep the current author if the user presses Enter
+    }
+
+    if (changeBook(db, current, newTitle, newAuthor)) {
+        std::cout << "Book updated successfully.\n";
+    }
+}
+
+// Function to give a book a new title and author, publish the change and reindex it
+bool changeBook(sqlite3* db,
+                const Book& current,
+                const std::string& newTitle,
+                const std::string& newAuthor) {
+    OperationTimer timer(METRIC_UPDATE);
+    // Use parameterized query to update the book
+    sqlite3_stmt* updateStmt;
+
+    int rc = sqlite3_prepare_v2(db, UPDATE_BOOK_SQL, -1, &updateStmt, nullptr);
+    if (rc != SQLITE_OK) {
+        handleSqliteError(db, "prepare statement");
+        return false;
+    }
+
+    sqlite3_bind_text(updateStmt, 1, newTitle.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(updateStmt, 2, newAuthor.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(updateStmt, 3, current.id);
+
+    rc = sqlite3_step(updateStmt);
+    sqlite3_finalize(updateStmt);
+    if (rc != SQLITE_DONE) {
+        handleSqliteError(db, "execute statement");
+        return false;
+    }
+
+    metrics.addRowsWritten(sqlite3_changes(db));
+    publishChanges(db);
+    unindexBook(current.id, current.title, current.author);
+    indexBook(current.id, newTitle, newAuthor);
+    timer.succeeded();
+    return true;
+}
+
+// Function to show analytical summaries computed over the columnar books snapshot
+void showCatalogStatistics(sqlite3* db) {
+    const char* topAuthorsSQL
+        = "SELECT min(author), COUNT(*) AS books FROM books_columnar "
+          "GROUP BY author_id ORDER BY books DESC LIMIT 10;";
+    const char* titleLengthsSQL
+        = "SELECT title_length / 10 * 10 AS bucket, COUNT(*) FROM books_columnar "
+          "GROUP BY bucket ORDER BY bucket;";
+
+    sqlite3_stmt* stmt;
+    int rc = sqlite3_prepare_v2(db, topAuthorsSQL, -1, &stmt, nullptr);
+    if (rc != SQLITE_OK) {
+        handleSqliteError(db, "prepare statement");
+        return;
+    }
+
+    std::cout << "Authors with the most books:\n";
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        std::cout << std::left << std::setw(24)
+                  << reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)) << " | "
+                  << sqlite3_column_int(stmt, 1) << "\n";
+    }
+    if (rc != SQLITE_DONE) {
+        handleSqliteError(db, "execute statement");
+    }
+    sqlite3_finalize(stmt);
+
+    rc = sqlite3_prepare_v2(db, titleLengthsSQL, -1, &stmt, nullptr);
+    if (rc != SQLITE_OK) {
+        handleSqliteError(db, "prepare statement");
+        return;
+    }
+
+    std::cout << "\nTitle length distribution:\n";
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        int bucket = sqlite3_column_int(stmt, 0);
+        std::cout << std::right << std::setw(4) << bucket << "-" << std::left << std::setw(4)
+                  << bucket + 9 << " | " << sqlite3_column_int(stmt, 1) << "\n";
+    }
+    if (rc != SQLITE_DONE) {
+        handleSqliteError(db, "execute statement");
+    }
+    sqlite3_finalize(stmt);
+
+    if (titleFilter.isBuilt()) {
+        std::cout << "\nTitle filter: " << titleFilter.lookupCount() << " lookups, "
+                  << titleFilter.probesSkipped() << " index probes skipped, false positive rate "
+                  << 100 * titleFilter.estimatedFalsePositiveRate() << "% estimated, "
+                  << 100 * titleFilter.observedFalsePositiveRate() << "% observed\n";
+    }
+
+    std::cout << "\n";
+    showStorageStatistics(db);
+
+    std::cout << "\nSQLite resources by operation:\n";
+    resourceAccounting.print(std::cout);
+}
+
+// Function to delete or re-author every book selected by an id file or a filter. The ids are
+// collected into a temporary table first, then applied in chunks of consecutive ids, each in
+// its own short write transaction, so other connections are never locked out for long.
+int runBulkOperation(sqlite3* db, const std::vector<std::string>& args, const char* program) {
+    bool isDelete = args[0] == "bulk-delete";
+    std::string idFile, author, titlePattern, newAuthor;
+    bool hasNewAuthor = false;
+    bool confirmed = false;
+    int chunkRows = BULK_CHUNK_ROWS;
+    for (size_t i = 1; i < args.size(); i++) {
+        if (args[i] == "--yes") {
+            confirmed = true;
+        } else if (i + 1 >= args.size()) {
+            printUsage(program);
+            return 1;
+        } else if (args[i] == "--ids") {
+            idFile = args[++i];
+        } else if (args[i] == "--author") {
+            author = args[++i];
+        } else if (args[i] == "--title-like") {
+            titlePattern = args[++i];
+        } else if (args[i] == "--set-author" && !isDelete) {
+            newAuthor = args[++i];
+            hasNewAuthor = true;
+        } else if (args[i] == "--chunk") {
+            chunkRows = std::max(std::stoi(args[++i]), 1);
+        } else {
+            printUsage(program);
+            return 1;
+        }
+    }
+    int selections = !idFile.empty() + !author.empty() + !titlePattern.empty();
+    if (selections != 1 || (!isDelete && !hasNewAuthor)) {
+        printUsage(program);
+        return 1;
+    }
+
+    auto exec = [db](const char* sql) {
+        if (sqlite3_exec(db, sql, nullptr, nullptr, nullptr) != SQLITE_OK) {
+            handleSqliteError(db, sql);
+            return false;
+        }
+        return true;
+    };
+    if (!exec("DROP TABLE IF EXISTS temp.bulk_ids;"
+              "CREATE TEMP TABLE bulk_ids (id INTEGER PRIMARY KEY);")) {
+        return 1;
+    }
+
+    // Collect the selected ids
+    sqlite3_stmt* stmt;
+    if (!idFile.empty()) {
+        std::ifstream in(idFile);
+        if (!in) {
+            std::cerr << "Cannot open " << idFile << "\n";
+            return 1;
+        }
+        const char* insertSQL = "INSERT OR IGNORE INTO temp.bulk_ids (id) VALUES (?);";
+        if (sqlite3_prepare_v2(db, insertSQL, -1, &stmt, nullptr) != SQLITE_OK) {
+            handleSqliteError(db, "prepare statement");
+            return 1;
+        }
+        if (!exec("BEGIN;")) {
+            sqlite3_finalize(stmt);
+            return 1;
+        }
+        std::string line;
+        for (int lineNumber = 1; std::getline(in, line); lineNumber++) {
+            size_t start = line.find_first_not_of(" \t\r");
+            if (start == std::string::npos) {
+                continue;
+            }
+            char* end;
+            long long id = std::strtoll(line.c_str() + start, &end, 10);
+            if (end == line.c_str() + start || line.find_first_not_of(" \t\r", end - line.c_str())
+                                                   != std::string::npos) {
+                std::cerr << idFile << ":" << lineNumber << ": not a book ID: " << line << "\n";
+                sqlite3_finalize(stmt);
+                exec("ROLLBACK;");
+                return 1;
+            }
+            // A lost id would leave the operation running on part of the selection
+            sqlite3_bind_int64(stmt, 1, id);
+            if (sqlite3_step(stmt) != SQLITE_DONE) {
+                handleSqliteError(db, "insert book ID");
+                sqlite3_finalize(stmt);
+                exec("ROLLBACK;");
+                return 1;
+            }
+            sqlite3_reset(stmt);
+        }
+        sqlite3_finalize(stmt);
+        if (!exec("COMMIT;")) {
+            exec("ROLLBACK;");
+            return 1;
+        }
+    } else {
+        const char* selectSQL
+            = author.empty() ? "INSERT INTO temp.bulk_ids SELECT id FROM books WHERE title LIKE ?;"
+                             : "INSERT INTO temp.bulk_ids SELECT id FROM books WHERE author = ?;";
+        if (sqlite3_prepare_v2(db, selectSQL, -1, &stmt, nullptr) != SQLITE_OK) {
+            handleSqliteError(db, "prepare statement");
+            return 1;
+        }
+        const std::string& value = author.empty() ? titlePattern : author;
+        sqlite3_bind_text(stmt, 1, value.c_str(), -1, SQLITE_STATIC);
+        int rc = sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
+        if (rc != SQLITE_DONE) {
+            handleSqliteError(db, "execute statement");
+            return 1;
+        }
+    }
+
+    int selected = 0;
+    if (sqlite3_prepare_v2(db, "SELECT COUNT(*) FROM temp.bulk_ids;", -1, &stmt, nullptr)
+        == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            selected = sqlite3_column_int(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+    }
+    if (selected == 0) {
+        std::cout << "No books selected.\n";
+        return 0;
+    }
+    if (!confirmed) {
+        char confirm;
+        std::cout << "You are about to " << (isDelete ? "delete " : "update ") << selected
+                  << " books. Are you sure? (y/n): ";
+        std::cin >> confirm;
+        if (confirm != 'y' && confirm != 'Y') {
+            std::cout << "Bulk " << (isDelete ? "deletion" : "update") << " canceled.\n";
+            return 0;
+        }
+    }
+
+    // Followers and change log readers must see bulk changes like any other write, so a catalog
+    // that has a change log or a changeset log gets the chunks captured and published as well
+    if (std::filesystem::exists(CHANGE_LOG_PATH) && !changeCapture.open(db, CHANGE_LOG_PATH)) {
+        return 1;
+    }
+#ifdef SQLITE_ENABLE_SESSION
+    if (std::filesystem::exists(CHANGESET_LOG_PATH)
+        && !changesetPublisher.open(db, CHANGESET_LOG_PATH)) {
+        handleSqliteError(db, "start replication session");
+        return 1;
+    }
+#endif
+
+    // Each chunk covers the next chunkRows selected ids, found before the write lock is taken
+    const char* boundSQL
+        = "SELECT max(id) FROM (SELECT id FROM temp.bulk_ids WHERE id > ?1 ORDER BY id LIMIT ?2);";
+    const char* applySQL
+        = isDelete ? "DELETE FROM books WHERE id IN "
+                     "(SELECT id FROM temp.bulk_ids WHERE id > ?1 AND id <= ?2);"
+                   : "UPDATE books SET author = ?3 WHERE id IN "
+                     "(SELECT id FROM temp.bulk_ids WHERE id > ?1 AND id <= ?2);";
+    sqlite3_stmt* boundStmt;
+    sqlite3_stmt* applyStmt;
+    if (sqlite3_prepare_v2(db, boundSQL, -1, &boundStmt, nullptr) != SQLITE_OK
+        || sqlite3_prepare_v2(db, applySQL, -1, &applyStmt, nullptr) != SQLITE_OK) {
+        handleSqliteError(db, "prepare statement");
+        sqlite3_finalize(boundStmt);
+        return 1;
+    }
+    sqlite3_bind_int(boundStmt, 2, chunkRows);
+    if (!isDelete) {
+        sqlite3_bind_text(applyStmt, 3, newAuthor.c_str(), -1, SQLITE_STATIC);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration longestLock{};
+    std::chrono::steady_clock::duration totalLock{};
+    int chunks = 0;
+    int64_t changed = 0;
+    sqlite3_int64 lastId = std::numeric_limits<sqlite3_int64>::min();
+    bool ok = true;
+    while (ok) {
+        sqlite3_bind_int64(boundStmt, 1, lastId);
+        bool more = sqlite3_step(boundStmt) == SQLITE_ROW
+                    && sqlite3_column_type(boundStmt, 0) != SQLITE_NULL;
+        sqlite3_int64 upperId = more ? sqlite3_column_int64(boundStmt, 0) : 0;
+        sqlite3_reset(boundStmt);
+        if (!more) {
+            break;
+        }
+
+        // The lock is timed from when BEGIN IMMEDIATE gets it, not from when it was asked for
+        ok = exec("BEGIN IMMEDIATE;");
+        if (ok) {
+            auto lockStart = std::chrono::steady_clock::now();
+            sqlite3_bind_int64(applyStmt, 1, lastId);
+            sqlite3_bind_int64(applyStmt, 2, upperId);
+            ok = sqlite3_step(applyStmt) == SQLITE_DONE;
+            sqlite3_reset(applyStmt);
+            if (!ok) {
+                handleSqliteError(db, "execute statement");
+                exec("ROLLBACK;");
+            } else {
+                changed += sqlite3_changes(db);
+                ok = exec("COMMIT;");
+            }
+            auto held = std::chrono::steady_clock::now() - lockStart;
+            longestLock = std::max(longestLock, held);
+            totalLock += held;
+            if (ok) {
+                publishChanges(db);
+            }
+        }
+        chunks++;
+        lastId = upperId;
+        std::this_thread::sleep_for(std::chrono::milliseconds(BULK_CHUNK_PAUSE_MS));
+    }
+    sqlite3_finalize(boundStmt);
+    sqlite3_finalize(applyStmt);
+    exec("DROP TABLE IF EXISTS temp.bulk_ids;");
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    auto toMs = [](std::chrono::steady_clock::duration duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    };
+    std::ostringstream summary;
+    summary << (isDelete ? "Deleted " : "Updated ") << changed << " of " << selected
+            << " selected books in " << chunks << " chunks of up to " << chunkRows << " ("
+            << std::fixed << std::setprecision(0)
+            << changed / std::max(toMs(elapsed) / 1000, 1e-6) << " rows/s); write lock held "
+            << std::setprecision(1) << toMs(totalLock) / std::max(chunks, 1) << " ms on average, "
+            << toMs(longestLock) << " ms at most.";
+    writeToLog(ok ? INFO : ERROR, summary.str());
+    std::cout << summary.str() << "\n";
+    return ok ? 0 : 1;
+}
+
+// Function to read an integer pragma such as page_count, returning -1 when it fails
+int pragmaValue(sqlite3* db, const char* pragma) {
+    std::string pragmaSQL = std::string("PRAGMA ") + pragma + ";";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, pragmaSQL.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        handleSqliteError(db, "prepare statement");
+        return -1;
+    }
+    int value = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int(stmt, 0) : -1;
+    sqlite3_finalize(stmt);
+    return value;
+}
+
+// Function to report free pages and how scattered and full the books table's leaf pages are.
+// Leaves are walked in key order through the dbstat virtual table; a leaf that does not follow
+// the previous one on disk turns a sequential scan into a seek.
+void showStorageStatistics(sqlite3* db) {
+    static const char* const autoVacuumModes[] = {"none", "full", "incremental"};
+    int pageSize = pragmaValue(db, "page_size");
+    int pageCount = pragmaValue(db, "page_count");
+    int freePages = pragmaValue(db, "freelist_count");
+    int autoVacuum = pragmaValue(db, "auto_vacuum");
+
+    std::cout << "Storage:\n";
+    std::cout << "Pages: " << pageCount << " of " << pageSize << " bytes ("
+              << static_cast<int64_t>(pageCount) * pageSize / 1024 << " KB)\n";
+    std::cout << "Free pages: " << freePages << " (" << std::fixed << std::setprecision(1)
+              << 100.0 * freePages / std::max(pageCount, 1) << "%)\n";
+    std::cout << "Auto-vacuum: "
+              << (autoVacuum >= 0 && autoVacuum <= 2 ? autoVacuumModes[autoVacuum] : "unknown")
+              << "\n";
+
+    const char* leavesSQL
+        = "SELECT pageno, unused FROM dbstat WHERE name = 'books' AND pagetype = 'leaf' "
+          "ORDER BY path;";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, leavesSQL, -1, &stmt, nullptr) != SQLITE_OK) {
+        std::cout << "Fragmentation: unavailable (SQLite built without dbstat)\n";
+        std::cout << std::defaultfloat;
+        return;
+    }
+    int64_t leaves = 0;
+    int64_t outOfOrder = 0;
+    int64_t unusedBytes = 0;
+    int64_t previous = -1;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        int64_t page = sqlite3_column_int64(stmt, 0);
+        if (previous >= 0 && page != previous + 1) {
+            outOfOrder++;
+        }
+        previous = page;
+        unusedBytes += sqlite3_column_int64(stmt, 1);
+        leaves++;
+    }
+    if (rc != SQLITE_DONE) {
+        handleSqliteError(db, "execute statement");
+    }
+    sqlite3_finalize(stmt);
+
+    std::cout << "Books leaf pages: " << leaves << ", " << outOfOrder << " out of order ("
+              << 100.0 * outOfOrder / std::max<int64_t>(leaves, 1) << "%), "
+              << 100.0 - 100.0 * unusedBytes / std::max<int64_t>(leaves * pageSize, 1)
+              << "% full\n";
+    std::cout << std::defaultfloat;
+}
+
+// Function to switch an existing database to incremental auto-vacuum. Leaving "none" needs a
+// full VACUUM, which rewrites the file; switching from "full" only changes the setting.
+int migrateToIncrementalVacuum(sqlite3* db) {
+    int mode = pragmaValue(db, "auto_vacuum");
+    if (mode == AUTO_VACUUM_INCREMENTAL) {
+        std::cout << "The database already uses incremental auto-vacuum.\n";
+        return 0;
+    }
+
+    int pagesBefore = pragmaValue(db, "page_count");
+    auto start = std::chrono::steady_clock::now();
+    const char* migrateSQL = mode == 0 ? "PRAGMA auto_vacuum = INCREMENTAL; VACUUM;"
+                                       : "PRAGMA auto_vacuum = INCREMENTAL;";
+    if (sqlite3_exec(db, migrateSQL, nullptr, nullptr, nullptr) != SQLITE_OK
+        || pragmaValue(db, "auto_vacuum") != AUTO_VACUUM_INCREMENTAL) {
+        handleSqliteError(db, "auto-vacuum migration");
+        return 1;
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+
+    std::string summary = "Converted to incremental auto-vacuum in "
+                          + std::to_string(elapsed.count()) + " ms; pages "
+                          + std::to_string(pagesBefore) + " -> "
+                          + std::to_string(pragmaValue(db, "page_count")) + ".";
+    writeToLog(INFO, summary);
+    std::cout << summary << "\n";
+    return 0;
+}
+
+// Function to bring an older or new database up to SCHEMA_VERSION. A current one costs a single
+// read of user_version; otherwise the idempotent DDL runs and the version is stamped.
+bool ensureSchema(sqlite3* db) {
+    int version = pragmaValue(db, "user_version");
+    if (version >= SCHEMA_VERSION) {
+        return true;
+    }
+
+    // New databases keep free pages for the maintenance task to release incrementally;
+    // existing ones are converted with "vacuum-migrate"
+    if (pragmaValue(db, "page_count") == 0) {
+        sqlite3_exec(db, "PRAGMA auto_vacuum = INCREMENTAL;", nullptr, nullptr, nullptr);
+    }
+
+    // Create a table to store the book data if it doesn't exist
+    const char* createTableSQL
+        = "CREATE TABLE IF NOT EXISTS books (id INTEGER PRIMARY KEY AUTOINCREMENT, "
+          "title TEXT UNIQUE, author TEXT);";
+    if (sqlite3_exec(db, createTableSQL, callback, 0, nullptr) != SQLITE_OK) {
+        handleSqliteError(db, "SQL table creation");
+        return false;
+    }
+
+    if (!ensureAuthorStats(db)) {
+        return false;
+    }
+
+    std::string versionSQL = "PRAGMA user_version = " + std::to_string(SCHEMA_VERSION) + ";";
+    if (sqlite3_exec(db, versionSQL.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK) {
+        handleSqliteError(db, "schema version update");
+        return false;
+    }
+    writeToLog(INFO, "Upgraded the schema from version " + std::to_string(version) + " to "
+                         + std::to_string(SCHEMA_VERSION) + ".");
+    return true;
+}
+
+// Function to create the author_stats table, which keeps the number of books per author up to
+// date through triggers on books so "books per author" is an index read instead of a GROUP BY
+// over the catalog. A new table is filled from the existing books in the same transaction.
+bool ensureAuthorStats(sqlite3* db) {
+    sqlite3_stmt* stmt;
+    const char* existsSQL
+        = "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'author_stats';";
+    if (sqlite3_prepare_v2(db, existsSQL, -1, &stmt, nullptr) != SQLITE_OK) {
+        handleSqliteError(db, "prepare statement");
+        return false;
+    }
+    bool exists = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+
+    // Books without an author are not counted, as the primary key cannot hold NULL
+    std::string schemaSQL
+        = "BEGIN IMMEDIATE;"
+          "CREATE TABLE IF NOT EXISTS author_stats ("
+          "    author TEXT PRIMARY KEY, book_count INTEGER NOT NULL) WITHOUT ROWID;"
+          "CREATE INDEX IF NOT EXISTS author_stats_by_count "
+          "    ON author_stats (book_count DESC, author);"
+          "CREATE TRIGGER IF NOT EXISTS author_stats_insert AFTER INSERT ON books "
+          "WHEN NEW.author IS NOT NULL BEGIN"
+          "    INSERT INTO author_stats (author, book_count) VALUES (NEW.author, 1)"
+          "        ON CONFLICT (author) DO UPDATE SET book_count = book_count + 1;"
+          "END;"
+          "CREATE TRIGGER IF NOT EXISTS author_stats_delete AFTER DELETE ON books "
+          "WHEN OLD.author IS NOT NULL BEGIN"
+          "    UPDATE author_stats SET book_count = book_count - 1 WHERE author = OLD.author;"
+          "    DELETE FROM author_stats WHERE author = OLD.author AND book_count <= 0;"
+          "END;"
+          "CREATE TRIGGER IF NOT EXISTS author_stats_update AFTER UPDATE OF author ON books "
+          "WHEN OLD.author IS NOT NEW.author BEGIN"
+          "    UPDATE author_stats SET book_count = book_count - 1 WHERE author = OLD.author;"
+          "    DELETE FROM author_stats WHERE author = OLD.author AND book_count <= 0;"
+          "    INSERT INTO author_stats (author, book_count)"
+          "        SELECT NEW.author, 1 WHERE NEW.author IS NOT NULL"
+          "        ON CONFLICT (author) DO UPDATE SET book_count = book_count + 1;"
+          "END;";
+    if (!exists) {
+        schemaSQL
+            += "INSERT INTO author_stats (author, book_count) "
+               "SELECT author, COUNT(*) FROM books WHERE author IS NOT NULL GROUP BY author;";
+    }
+    schemaSQL += "COMMIT;";
+
+    char* errorMessage = nullptr;
+    if (sqlite3_exec(db, schemaSQL.c_str(), nullptr, nullptr, &errorMessage) != SQLITE_OK) {
+        std::cerr << "SQL error: " << errorMessage << "\n";
+        writeToLog(ERROR, std::string("Cannot create author_stats: ") + errorMessage);
+        sqlite3_free(errorMessage);
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        return false;
+    }
+    if (!exists) {
+        writeToLog(INFO, "Created author_stats from the existing books.");
+    }
+    return true;
+}
+
+// Function to list the authors with the most books from the author_stats index
+void listTopAuthors(sqlite3* db, int limit) {
+    sqlite3_stmt* stmt;
+    int rc = sqlite3_prepare_v2(db, TOP_AUTHORS_SQL, -1, &stmt, nullptr);
+    if (rc != SQLITE_OK) {
+        handleSqliteError(db, "prepare statement");
+        return;
+    }
+    sqlite3_bind_int(stmt, 1, limit);
+
+    std::cout << std::left << std::setw(24) << "Author"
+              << " | Books\n";
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        std::cout << std::left << std::setw(24)
+                  << reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)) << " | "
+                  << sqlite3_column_int(stmt, 1) << "\n";
+    }
+    if (rc != SQLITE_DONE) {
+        handleSqliteError(db, "execute statement");
+    }
+    sqlite3_finalize(stmt);
+}
+
+// Function to apply random inserts, renames, author changes and deletes inside a transaction,
+// comparing author_stats with a full GROUP BY after every round, then roll everything back.
+// Returns 0 when every round matched.
+int checkAuthorStats(sqlite3* db, int rounds, unsigned seed) {
+    const char* mismatchSQL
+        = "SELECT (SELECT COUNT(*) FROM ("
+          "    SELECT author, COUNT(*) FROM books WHERE author IS NOT NULL GROUP BY author"
+          "    EXCEPT SELECT author, book_count FROM author_stats))"
+          " + (SELECT COUNT(*) FROM ("
+          "    SELECT author, book_count FROM author_stats"
+          "    EXCEPT SELECT author, COUNT(*) FROM books WHERE author IS NOT NULL"
+          "    GROUP BY author));";
+    const char* operationSQL[] = {
+        "INSERT INTO books (title, author) VALUES (?1, ?2);",
+        "UPDATE books SET title = ?1 WHERE id = (SELECT id FROM books WHERE id >= ?3 LIMIT 1);",
+        "UPDATE books SET author = ?2 WHERE id = (SELECT id FROM books WHERE id >= ?3 LIMIT 1);",
+        "DELETE FROM books WHERE id = (SELECT id FROM books WHERE id >= ?3 LIMIT 1);",
+    };
+    const int operationCount = sizeof(operationSQL) / sizeof(operationSQL[0]);
+
+    std::mt19937 random(seed);
+    std::cout << "Checking author_stats with seed " << seed << "\n";
+    if (sqlite3_exec(db, "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        handleSqliteError(db, "begin transaction");
+        return 1;
+    }
+
+    sqlite3_stmt* statements[operationCount] = {};
+    sqlite3_stmt* mismatchStmt = nullptr;
+    bool ok = sqlite3_prepare_v2(db, mismatchSQL, -1, &mismatchStmt, nullptr) == SQLITE_OK;
+    for (int i = 0; ok && i < operationCount; i++) {
+        ok = sqlite3_prepare_v2(db, operationSQL[i], -1, &statements[i], nullptr) == SQLITE_OK;
+    }
+    if (!ok) {
+        handleSqliteError(db, "prepare statement");
+    }
+
+    // Existing rows are picked by probing random ids up to the largest one
+    sqlite3_int64 maxId = 0;
+    sqlite3_stmt* maxIdStmt;
+    if (ok && sqlite3_prepare_v2(db, "SELECT max(id) FROM books;", -1, &maxIdStmt, nullptr)
+                  == SQLITE_OK) {
+        if (sqlite3_step(maxIdStmt) == SQLITE_ROW) {
+            maxId = sqlite3_column_int64(maxIdStmt, 0);
+        }
+        sqlite3_finalize(maxIdStmt);
+    }
+    int failedRounds = 0;
+    for (int round = 0; ok && round < rounds; round++) {
+        for (int step = 0; step < AUTHOR_STATS_CHECK_OPERATIONS; step++) {
+            // Authors come from a small pool so that counts collide, plus the odd NULL
+            std::string title = "author_stats check " + std::to_string(round) + "."
+                                + std::to_string(step) + "." + std::to_string(random());
+            std::string author = "Check Author " + std::to_string(random() % 7);
+
+            sqlite3_stmt* stmt = statements[random() % operationCount];
+            sqlite3_bind_text(stmt, 1, title.c_str(), -1, SQLITE_TRANSIENT);
+            if (random() % 10 == 0) {
+                sqlite3_bind_null(stmt, 2);
+            } else {
+                sqlite3_bind_text(stmt, 2, author.c_str(), -1, SQLITE_TRANSIENT);
+            }
+            sqlite3_bind_int64(stmt, 3, maxId > 0 ? 1 + random() % maxId : 0);
+            if (sqlite3_step(stmt) != SQLITE_DONE) {
+                handleSqliteError(db, "execute statement");
+            }
+            sqlite3_reset(stmt);
+            maxId = std::max(maxId, sqlite3_last_insert_rowid(db));
+        }
+
+        int mismatches = -1;
+        if (sqlite3_step(mismatchStmt) == SQLITE_ROW) {
+            mismatches = sqlite3_column_int(mismatchStmt, 0);
+        }
+        sqlite3_reset(mismatchStmt);
+        if (mismatches != 0) {
+            std::cout << "Round " << round + 1 << ": " << mismatches
+                      << " authors differ from GROUP BY\n";
+            failedRounds++;
+        }
+    }
+
+    for (sqlite3_stmt* stmt : statements) {
+        sqlite3_finalize(stmt);
+    }
+    sqlite3_finalize(mismatchStmt);
+    sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+
+    if (!ok || failedRounds > 0) {
+        std::cout << "author_stats check failed in " << failedRounds << " of " << rounds
+                  << " rounds.\n";
+        return 1;
+    }
+    std::cout << "author_stats matched GROUP BY after all " << rounds << " rounds.\n";
+    return 0;
+}
+
+// Function to print the query plan of each statement the menu runs and flag the ones that scan
+// a whole table where an index was expected; returns 1 when any did, so scripts can gate on it
+int explainStatements(sqlite3* db) {
+    struct Statement {
+        const char* name;
+        std::string sql;
+        bool expectsIndex;
+    };
+    const Statement statements[] = {
+        {"add: check title", TITLE_EXISTS_SQL, true},
+        {"view by title", listBooksSQL("title", false, 0, false), true},
+        {"view first titles",
+         listBooksSQL("title", false, VIEW_PAGE_ROWS, !hasLeadingIndex(db, "title")), true},
+        {"view by author", listBooksSQL("author", false, 0, false), false},
+        {"view first authors",
+         listBooksSQL("author", false, VIEW_PAGE_ROWS, !hasLeadingIndex(db, "author")), false},
+        {"search", FIND_BOOKS_SQL, true},
+        {"update: check id", CHECK_BOOK_SQL, true},
+        {"update and delete: fetch", FETCH_BOOK_SQL, true},
+        {"update", UPDATE_BOOK_SQL, true},
+        {"delete", DELETE_BOOK_SQL, true},
+        {"top authors", TOP_AUTHORS_SQL, true},
+    };
+
+    // "SCAN books", or "SCAN TABLE books" before SQLite 3.36; index scans name their index
+    auto scansWholeTable = [](const std::string& detail) {
+        return detail.rfind("SCAN ", 0) == 0 && detail.find(" USING ") == std::string::npos
+               && detail != "SCAN CONSTANT ROW";
+    };
+
+    int regressions = 0;
+    for (const Statement& statement : statements) {
+        std::string explainSQL = "EXPLAIN QUERY PLAN " + statement.sql;
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(db, explainSQL.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+            handleSqliteError(db, "explain statement");
+            return 1;
+        }
+
+        std::cout << statement.name
+                  << (statement.expectsIndex ? " (index expected)" : " (scan allowed)") << "\n";
+        std::unordered_map<int, int> depths;
+        bool scans = false;
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            int id = sqlite3_column_int(stmt, 0);
+            auto parent = depths.find(sqlite3_column_int(stmt, 1));
+            int depth = parent == depths.end() ? 1 : parent->second + 1;
+            depths[id] = depth;
+
+            const unsigned char* text = sqlite3_column_text(stmt, 3);
+            std::string detail = text ? reinterpret_cast<const char*>(text) : "";
+            std::cout << std::string(2 * depth, ' ') << detail << "\n";
+            scans = scans || scansWholeTable(detail);
+        }
+        sqlite3_finalize(stmt);
+
+        if (statement.expectsIndex && scans) {
+            std::cout << "  REGRESSION: scans a whole table where an index was expected\n";
+            regressions++;
+        }
+    }
+
+    if (regressions > 0) {
+        std::cout << regressions << " of " << std::size(statements)
+                  << " statements lost their index.\n";
+        return 1;
+    }
+    std::cout << "All " << std::size(statements) << " statements use the expected plans.\n";
+    return 0;
+}
+
+// Function to fill the catalog with generated books until it holds at least the given number,
+// then refresh the planner statistics, so checks such as "main explain" see a realistic table
+int seedCatalog(sqlite3* db, int books) {
+    std::string seedSQL
+        = "WITH RECURSIVE n(i) AS (SELECT (SELECT COUNT(*) FROM books) + 1 UNION ALL "
+          "SELECT i + 1 FROM n WHERE i < "
+          + std::to_string(books)
+          + ") INSERT INTO books (title, author) SELECT 'Seeded book ' || i, 'Seeded Author ' "
+            "|| (i % "
+          + std::to_string(SEED_AUTHORS) + ") FROM n WHERE i <= " + std::to_string(books)
+          + "; ANALYZE;";
+    if (sqlite3_exec(db, seedSQL.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK) {
+        handleSqliteError(db, "seed catalog");
+        return 1;
+    }
+    std::cout << "The catalog holds at least " << books << " books.\n";
+    return 0;
+}
+
+// Function to take an online backup of the database to a file chosen by the user
+void backupBooks(sqlite3* db) {
+    std::string destination;
+    std::cout << "Enter the backup file name: ";
+    std::cin.ignore();
+    std::getline(std::cin, destination);
+
+    bool ok = backupDatabase(db, destination, [](int remaining, int total) {
+        int percent = total > 0 ? 100 * (total - remaining) / total : 100;
+        std::cout << "\rBackup progress: " << percent << "% (" << total - remaining << "/" << total
+                  << " pages)" << std::flush;
+    });
+    std::cout << "\n";
+    if (ok) {
+        std::cout << "Backup written to " << destination << ".\n";
+    } else {
+        std::cout << "Backup failed.\n";
+    }
+}
+
+// Function to copy the live database into a file with the backup API. Pages are copied a few
+// at a time with a pause in between, so locks are only ever held for one short step and
+// addBook or searchBooks never stall behind a backup. The copy is written next to the
+// destination and renamed over it once complete, so a failed backup never clobbers a good one.
+bool backupDatabase(sqlite3* db,
+                    const std::string& destination,
+                    const std::function<void(int, int)>& progress,
+                    int pagesPerStep) {
+    OperationTimer timer(METRIC_BACKUP);
+    std::string partial = destination + ".partial";
+    sqlite3* target;
+    if (sqlite3_open(partial.c_str(), &target) != SQLITE_OK) {
+        handleSqliteError(target, "open backup file");
+        sqlite3_close(target);
+        return false;
+    }
+
+    sqlite3_backup* backup = sqlite3_backup_init(target, "main", db, "main");
+    if (!backup) {
+        handleSqliteError(target, "start backup");
+        sqlite3_close(target);
+        std::remove(partial.c_str());
+        return false;
+    }
+
+    int rc;
+    do {
+        rc = sqlite3_backup_step(backup, pagesPerStep);
+        if (progress) {
+            progress(sqlite3_backup_remaining(backup), sqlite3_backup_pagecount(backup));
+        }
+        if (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED) {
+            sqlite3_sleep(BACKUP_STEP_PAUSE_MS);
+        }
+    } while (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED);
+
+    sqlite3_backup_finish(backup);
+    if (rc != SQLITE_DONE) {
+        handleSqliteError(target, "backup step");
+    }
+    sqlite3_close(target);
+
+    if (rc != SQLITE_DONE) {
+        std::remove(partial.c_str());
+        return false;
+    }
+    // POSIX rename replaces the old backup atomically; Windows needs it removed first
+    if (std::rename(partial.c_str(), destination.c_str()) != 0
+        && (std::remove(destination.c_str()) != 0
+            || std::rename(partial.c_str(), destination.c_str()) != 0)) {
+        std::cerr << "Could not move the backup into place at " << destination << "\n";
+        return false;
+    }
+    timer.succeeded();
+    return true;
+}
+
+// Function to check that a backup taken while another connection keeps writing is a consistent
+// copy: every row present when it started, none half-written, and of the rows written during
+// the backup exactly those committed before some point. The rows it adds are deleted again.
+int checkConcurrentBackup(sqlite3* db, int writes) {
+    const std::string copyPath = "books.backup-check.db";
+    auto count = [](sqlite3* connection, const std::string& sql) {
+        sqlite3_stmt* stmt;
+        int value = -1;
+        if (sqlite3_prepare_v2(connection, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK
+            && sqlite3_step(stmt) == SQLITE_ROW) {
+            value = sqlite3_column_int(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+        return value;
+    };
+    auto cleanUp = [&] {
+        sqlite3_exec(db, "DELETE FROM books WHERE title LIKE 'backup check %';", nullptr, nullptr,
+                     nullptr);
+        std::remove(copyPath.c_str());
+    };
+
+    // Enough rows that the backup takes many steps for the writer to land between
+    std::string seedSQL
+        = "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < "
+          + std::to_string(BACKUP_CHECK_SEED_ROWS)
+          + ") INSERT INTO books (title, author) SELECT 'backup check seed ' || i, "
+            "'Backup Check' FROM n;";
+    if (sqlite3_exec(db, seedSQL.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK) {
+        handleSqliteError(db, "seed backup check rows");
+        cleanUp();
+        return 1;
+    }
+    int rowsBefore = count(db, "SELECT COUNT(*) FROM books;");
+
+    // The writer has a connection of its own, so each of its commits restarts the backup
+    sqlite3* writerDb;
+    if (sqlite3_open(sqlite3_db_filename(db, "main"), &writerDb) != SQLITE_OK) {
+        handleSqliteError(writerDb, "open writer connection");
+        sqlite3_close(writerDb);
+        cleanUp();
+        return 1;
+    }
+    sqlite3_busy_timeout(writerDb, BUSY_TIMEOUT_MS);
+    std::atomic<bool> backupRunning{true};
+    std::atomic<int> writesDuringBackup{0};
+    std::atomic<int> failedWrites{0};
+    std::thread writer([&] {
+        for (int i = 0; i < writes; i++) {
+            std::string sql = "INSERT INTO books (title, author) VALUES ('backup check write "
+                              + std::to_string(i) + "', 'Backup Check');";
+            if (sqlite3_exec(writerDb, sql.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK) {
+                failedWrites++;
+            } else if (backupRunning) {
+                writesDuringBackup++;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(BACKUP_STEP_PAUSE_MS));
+        }
+    });
+
+    int steps = 0;
+    bool ok = backupDatabase(
+        db, copyPath, [&](int, int) { steps++; }, BACKUP_CHECK_PAGES_PER_STEP);
+    backupRunning = false;
+    writer.join();
+    sqlite3_close(writerDb);
+
+    sqlite3* copy = nullptr;
+    if (ok
+        && sqlite3_open_v2(copyPath.c_str(), &copy, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+        handleSqliteError(copy, "open backup copy");
+        sqlite3_close(copy);
+        ok = false;
+    }
+    if (ok) {
+        sqlite3_stmt* integrity;
+        ok = sqlite3_prepare_v2(copy, "PRAGMA integrity_check;", -1, &integrity, nullptr)
+                 == SQLITE_OK
+             && sqlite3_step(integrity) == SQLITE_ROW
+             && std::string(reinterpret_cast<const char*>(sqlite3_column_text(integrity, 0)))
+                    == "ok";
+        sqlite3_finalize(integrity);
+        if (!ok) {
+            std::cout << "The backup copy failed its integrity check.\n";
+        }
+
+        // Writes are numbered in commit order, so a consistent copy holds a prefix of them
+        int copiedWrites = count(copy, "SELECT COUNT(*) FROM books WHERE title LIKE "
+                                       "'backup check write %';");
+        int lastWrite = count(copy, "SELECT COALESCE(MAX(CAST(substr(title, 20) AS INTEGER)), "
+                                    "-1) FROM books WHERE title LIKE 'backup check write %';");
+        int copiedRows = count(copy, "SELECT COUNT(*) FROM books;");
+        sqlite3_close(copy);
+        std::cout << "Backup took " << steps << " steps while " << writesDuringBackup << " of "
+                  << writes << " writes committed; the copy holds " << copiedRows
+                  << " rows including " << copiedWrites << " of those writes.\n";
+        if (copiedRows != rowsBefore + copiedWrites || lastWrite != copiedWrites - 1) {
+            std::cout << "The backup copy is not a consistent snapshot.\n";
+            ok = false;
+        }
+    }
+    if (failedWrites > 0) {
+        std::cout << failedWrites << " writes failed during the backup.\n";
+        ok = false;
+    }
+    cleanUp();
+    std::cout << (ok ? "Backup under concurrent writes passed.\n"
+                     : "Backup under concurrent writes failed.\n");
+    return ok ? 0 : 1;
+}
+
+// Function to print the change log as tab-separated text, optionally waiting for new records
+// like tail -f so downstream caches can subscribe to it
+int tailChangeLog(const std::string& path, uint64_t fromSequence, bool follow) {
+    FramedLogReader log;
+    if (!log.open(path, CHANGE_LOG_MAGIC)) {
+        std::cerr << "No change log at " << path << "\n";
+        return 1;
+    }
+
+    uint64_t sequence;
+    std::string record;
+    while (true) {
+        if (!log.next(sequence, record)) {
+            if (!follow) {
+                return 0;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(LOG_POLL_MS));
+            continue;
+        }
+
+        int64_t rowid;
+        uint32_t titleLength, authorLength;
+        const char* p = record.data();
+        std::memcpy(&rowid, p, sizeof(rowid));
+        char op = *(p += sizeof(rowid));
+        std::memcpy(&titleLength, p += 1, sizeof(titleLength));
+        std::string title(p += sizeof(titleLength), titleLength);
+        std::memcpy(&authorLength, p += titleLength, sizeof(authorLength));
+        std::string author(p + sizeof(authorLength), authorLength);
+
+        if (sequence >= fromSequence) {
+            std::cout << sequence << "\t" << op << "\t" << rowid << "\t" << title << "\t" << author
+                      << std::endl;
+        }
+    }
+}
+
+#ifdef SQLITE_ENABLE_SESSION
+// Replicated rows come from the leader, which is always right
+static int replaceOnConflict(void*, int conflict, sqlite3_changeset_iter*) {
+    if (conflict == SQLITE_CHANGESET_DATA || conflict == SQLITE_CHANGESET_CONFLICT) {
+        return SQLITE_CHANGESET_REPLACE;
+    }
+    return SQLITE_CHANGESET_OMIT;
+}
+
+// Function to bring a follower database up to date with the leader's changeset log. The
+// follower stores the sequence number of the last applied changeset in the same transaction
+// as the changes, so an interrupted run resumes exactly where it stopped. A new follower is
+// seeded with an online backup of the leader; changesets that were already part of that
+// copy are absorbed by the conflict handler.
+int replicateFollower(sqlite3* leader,
+                      const std::string& followerPath,
+                      bool follow,
+                      const std::string& logPath) {
+    sqlite3* follower;
+    if (sqlite3_open(followerPath.c_str(), &follower) != SQLITE_OK) {
+        handleSqliteError(follower, "open follower");
+        sqlite3_close(follower);
+        return 1;
+    }
+
+    auto exec = [follower](const char* sql) {
+        if (sqlite3_exec(follower, sql, nullptr, nullptr, nullptr) != SQLITE_OK) {
+            handleSqliteError(follower, sql);
+            return false;
+        }
+        return true;
+    };
+
+    uint64_t position = 0;
+    bool seeded = false;
+    sqlite3_stmt* stmt;
+    const char* positionSQL = "SELECT position FROM replication_state;";
+    if (sqlite3_prepare_v2(follower, positionSQL, -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            position = sqlite3_column_int64(stmt, 0);
+            seeded = true;
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    FramedLogReader log;
+    if (!log.open(logPath, CHANGESET_LOG_MAGIC)) {
+        std::cerr << "No changeset log at " << logPath
+                  << "; run the leader with --publish-changesets\n";
+        sqlite3_close(follower);
+        return 1;
+    }
+
+    uint64_t sequence;
+    std::string changeset;
+    if (!seeded) {
+        // Everything logged so far is in the copy
+        while (log.next(sequence, changeset)) {
+            position = sequence;
+        }
+        sqlite3_close(follower);
+        std::cout << "Seeding follower " << followerPath << " from the leader...\n";
+        if (!backupDatabase(leader, followerPath, nullptr)
+            || sqlite3_open(followerPath.c_str(), &follower) != SQLITE_OK) {
+            return 1;
+        }
+        if (!exec("CREATE TABLE replication_state (position INTEGER NOT NULL);")) {
+            sqlite3_close(follower);
+            return 1;
+        }
+        std::string insertSQL
+            = "INSERT INTO replication_state VALUES (" + std::to_string(position) + ");";
+        if (!exec(insertSQL.c_str())) {
+            sqlite3_close(follower);
+            return 1;
+        }
+    }
+
+    const char* updatePositionSQL = "UPDATE replication_state SET position = ?;";
+    sqlite3_stmt* positionStmt;
+    if (sqlite3_prepare_v2(follower, updatePositionSQL, -1, &positionStmt, nullptr) != SQLITE_OK) {
+        handleSqliteError(follower, "prepare statement");
+        sqlite3_close(follower);
+        return 1;
+    }
+
+    // Changesets are applied in batches so a busy leader does not cost a commit per write. A
+    // batch that fails to apply or commit is rolled back and leaves the position where it was.
+    uint64_t applied = 0;
+    bool failed = false;
+    auto start = std::chrono::steady_clock::now();
+    while (true) {
+        size_t batch = 0;
+        uint64_t committedPosition = position;
+        bool ok = exec("BEGIN;");
+        while (ok && batch < REPLICATION_BATCH && log.next(sequence, changeset)) {
+            if (sequence <= position) {
+                continue;
+            }
+            int rc = sqlite3changeset_apply(follower,
+                                            static_cast<int>(changeset.size()),
+                                            &changeset[0],
+                                            nullptr,
+                                            replaceOnConflict,
+                                            nullptr);
+            if (rc != SQLITE_OK) {
+                handleSqliteError(follower, "apply changeset");
+                ok = false;
+                break;
+            }
+            position = sequence;
+            batch++;
+        }
+        if (ok && batch > 0) {
+            sqlite3_bind_int64(positionStmt, 1, static_cast<sqlite3_int64>(position));
+            ok = sqlite3_step(positionStmt) == SQLITE_DONE;
+            if (!ok) {
+                handleSqliteError(follower, "update replication position");
+            }
+            sqlite3_reset(positionStmt);
+        }
+        if (ok) {
+            ok = exec("COMMIT;");
+        }
+        if (!ok) {
+            if (!sqlite3_get_autocommit(follower)) {
+                exec("ROLLBACK;");
+            }
+            position = committedPosition;
+            failed = true;
+            break;
+        }
+        applied += batch;
+
+        if (batch < REPLICATION_BATCH) {
+            if (!follow) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(LOG_POLL_MS));
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double seconds = elapsed.count();
+    std::cout << "Applied " << applied << " changesets in " << seconds << " s; follower is at "
+              << "position " << position << ".\n";
+    sqlite3_finalize(positionStmt);
+    sqlite3_close(follower);
+    return failed ? 1 : 0;
+}
+
+// Function to measure replication end to end on scratch files: a leader of REPLICATION_BENCH_ROWS
+// books publishes one changeset per single-row update, a follower seeded before the updates
+// applies them all, and the two must end up identical. The leader runs in WAL mode with
+// synchronous=NORMAL, so commits do not wait for the disk and the figures are the cost of
+// capturing and applying changes.
+int benchmarkReplication(int updates) {
+    const std::string leaderPath = "books.replication-bench.db";
+    const std::string followerPath = "books.replication-bench.follower.db";
+    const std::string logPath = "books.replication-bench.changesets";
+    auto removeScratchFiles = [&] {
+        for (const std::string& path : {leaderPath, followerPath, logPath}) {
+            std::remove(path.c_str());
+            std::remove((path + "-wal").c_str());
+            std::remove((path + "-shm").c_str());
+        }
+    };
+    removeScratchFiles();
+
+    sqlite3* leader;
+    if (sqlite3_open(leaderPath.c_str(), &leader) != SQLITE_OK) {
+        handleSqliteError(leader, "open replication leader");
+        sqlite3_close(leader);
+        return 1;
+    }
+    std::string seedSQL = "PRAGMA journal_mode = WAL; PRAGMA synchronous = NORMAL; "
+                          "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n "
+                          "WHERE i < "
+                          + std::to_string(REPLICATION_BENCH_ROWS)
+                          + ") INSERT INTO books (title, author) SELECT 'Replicated book ' || i, "
+                            "'Author 0' FROM n;";
+    bool ok = ensureSchema(leader)
+              && sqlite3_exec(leader, seedSQL.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK;
+    if (!ok) {
+        handleSqliteError(leader, "seed replication leader");
+    }
+
+    double publishSeconds = 0;
+    if (ok) {
+        ChangesetPublisher publisher;
+        sqlite3_stmt* stmt = nullptr;
+        ok = publisher.open(leader, logPath)
+             && replicateFollower(leader, followerPath, false, logPath) == 0
+             && sqlite3_prepare_v2(leader, "UPDATE books SET author = ? WHERE id = ?;", -1, &stmt,
+                                   nullptr)
+                    == SQLITE_OK;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; ok && i < updates; i++) {
+            std::string author = "Author " + std::to_string(i + 1);
+            sqlite3_bind_text(stmt, 1, author.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int(stmt, 2, 1 + i % REPLICATION_BENCH_ROWS);
+            ok = sqlite3_step(stmt) == SQLITE_DONE;
+            sqlite3_reset(stmt);
+            publisher.publish();
+        }
+        publishSeconds
+            = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (!ok) {
+            handleSqliteError(leader, "replication benchmark update");
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    std::ifstream log(logPath, std::ios::binary | std::ios::ate);
+    double logMegabytes = log ? static_cast<double>(log.tellg()) / (1024 * 1024) : 0;
+    auto start = std::chrono::steady_clock::now();
+    ok = ok && replicateFollower(leader, followerPath, false, logPath) == 0;
+    double applySeconds
+        = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // The follower must hold exactly the leader's rows
+    int differences = -1;
+    std::string compareSQL
+        = "ATTACH '" + followerPath
+          + "' AS follower; SELECT (SELECT COUNT(*) FROM (SELECT id, title, author FROM "
+            "main.books EXCEPT SELECT id, title, author FROM follower.books)) + (SELECT COUNT(*) "
+            "FROM (SELECT id, title, author FROM follower.books EXCEPT SELECT id, title, author "
+            "FROM main.books));";
+    if (ok) {
+        sqlite3_exec(
+            leader, compareSQL.c_str(),
+            [](void* result, int, char** values, char**) {
+                *static_cast<int*>(result) = values[0] ? std::atoi(values[0]) : -1;
+                return 0;
+            },
+            &differences, nullptr);
+    }
+    sqlite3_close(leader);
+    removeScratchFiles();
+
+    std::cout << std::fixed << std::setprecision(1) << updates << " updates published in "
+              << publishSeconds << " s (" << updates / std::max(publishSeconds, 1e-9)
+              << " per second), " << logMegabytes << " MB of changesets applied in "
+              << applySeconds << " s (" << updates / std::max(applySeconds, 1e-9)
+              << " per second)\n"
+              << std::defaultfloat;
+    if (!ok || differences != 0) {
+        std::cout << "Replication benchmark failed: the follower differs from the leader in "
+                  << differences << " rows.\n";
+        return 1;
+    }
+    std::cout << "The follower matches the leader.\n";
+    return 0;
+}
+#endif
+
+// Function to parse a whole argument as a book ID
+bool parseBookId(const std::string& text, sqlite3_int64& id) {
+    char* end;
+    errno = 0;
+    id = std::strtoll(text.c_str(), &end, 10);
+    return !text.empty() && *end == '\0' && errno == 0;
+}
+
+// Function to parse a worker thread count, accepting 1 up to MAX_THREADS_PER_CORE threads per
+// hardware thread
+bool parseThreadCount(const std::string& text, size_t& threads) {
+    char* end;
+    errno = 0;
+    long long count = std::strtoll(text.c_str(), &end, 10);
+    size_t limit = MAX_THREADS_PER_CORE * std::max(1u, std::thread::hardware_concurrency());
+    if (text.empty() || *end != '\0' || errno != 0 || count < 1
+        || static_cast<size_t>(count) > limit) {
+        return false;
+    }
+    threads = static_cast<size_t>(count);
+    return true;
+}
+
+// Function to run a command against the sharded catalog
+int runShardCommand(size_t shardCount,
+                    const std::vector<std::string>& args,
+                    const char* program) {
+    ShardedCatalog catalog;
+    if (!catalog.open(shardCount)) {
+        return 1;
+    }
+
+    const std::string& command = args[0];
+    sqlite3_int64 id = 0;
+    if ((command == "update" || command == "delete") && args.size() >= 2
+        && !parseBookId(args[1], id)) {
+        std::cerr << "Not a book ID: " << args[1] << "\n";
+        return 1;
+    }
+    if (command == "add" && args.size() == 3) {
+        id = catalog.addBook(args[1], args[2]);
+        if (id == 0) {
+            return 1;
+        }
+        std::cout << "Book added successfully with ID " << id << ".\n";
+    } else if (command == "update" && args.size() == 4) {
+        if (!catalog.updateBook(id, args[2], args[3])) {
+            std::cout << "Book with ID " << args[1] << " could not be updated.\n";
+            return 1;
+        }
+        std::cout << "Book updated successfully.\n";
+    } else if (command == "delete" && args.size() == 2) {
+        if (!catalog.deleteBook(id)) {
+            std::cout << "Book with ID " << args[1] << " does not exist in the catalog.\n";
+            return 1;
+        }
+        std::cout << "Book deleted successfully.\n";
+    } else if (command == "search" && args.size() == 2) {
+        std::cout << "Search Results:\n";
+        printBookTableHeader();
+        return catalog.searchBooks(args[1], printBookRow) ? 0 : 1;
+    } else if (command == "view" && args.size() <= 3) {
+        std::string orderBy = args.size() >= 2 ? args[1] : "title";
+        bool descending = args.size() == 3 && args[2] == "desc";
+        if (orderBy != "title" && orderBy != "author") {
+            printUsage(program);
+            return 1;
+        }
+        printBookTableHeader();
+        return catalog.viewBooks(orderBy, descending, printBookRow) ? 0 : 1;
+    } else {
+        printUsage(program);
+        return 1;
+    }
+    return 0;
+}
+
+// Function to push many concurrent logical requests through the coroutine API and report the
+// throughput. Each request adds a book, reads it back, finds it by search, renames it and
+// deletes it, suspending at every step instead of holding a thread.
+int runAsyncBenchmark(const std::string& file, size_t requests, size_t readerThreads) {
+    AsyncBookStore store;
+    if (!store.open(file, readerThreads)) {
+        return 1;
+    }
+
+    std::mutex mutex;
+    std::condition_variable allFinished;
+    size_t remaining = requests;
+    std::atomic<size_t> failures{0};
+
+    auto request = [&](size_t number) -> Detached {
+        std::string title = "Async benchmark " + std::to_string(number);
+        int bookId = co_await store.addBook(title, "Benchmark");
+        bool ok = bookId != 0;
+        if (ok) {
+            std::optional<Book> book = co_await store.getBook(bookId);
+            ok = book && book->title == title;
+        }
+        if (ok) {
+            size_t matches = 0;
+            AsyncGenerator<Book> results = store.searchBooks(title);
+            while (const Book* book = co_await results.next()) {
+                matches += book->id == bookId;
+            }
+            ok = matches == 1;
+        }
+        if (ok) {
+            ok = co_await store.updateBook(bookId, title + " (renamed)", "Benchmark");
+        }
+        if (ok) {
+            ok = co_await store.deleteBook(bookId);
+        }
+        if (!ok) {
+            failures++;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--remaining == 0) {
+            allFinished.notify_all();
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < requests; i++) {
+        request(i);
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        allFinished.wait(lock, [&remaining] { return remaining == 0; });
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+
+    double seconds = std::max<double>(elapsed.count(), 1) / 1e6;
+    std::cout << requests << " concurrent requests (" << requests * 5 << " operations) on "
+              << store.threadCount() << " threads in " << std::fixed << std::setprecision(1)
+              << seconds * 1000 << " ms: " << std::setprecision(0) << requests * 5 / seconds
+              << " operations/s, " << failures << " failed\n";
+    return failures == 0 ? 0 : 1;
+}
+
+// Function to time formatting a log timestamp per message, as writeToLog used to with a
+// calendar conversion and put_time, against the cached LogClock, and then whole events through
+// the text and binary loggers
+int benchmarkLogTimestamps(size_t iterations) {
+    iterations = std::max<size_t>(iterations, 1);
+    std::string line;
+    size_t checksum = 0;
+    auto measure = [&](const char* name, const std::function<void()>& format) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; i++) {
+            line.clear();
+            format();
+            checksum += line.size();
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start);
+        std::cout << std::left << std::setw(34) << name << std::right << std::setw(8)
+                  << std::fixed << std::setprecision(1)
+                  << static_cast<double>(elapsed.count()) / iterations << " ns per timestamp\n";
+    };
+
+    std::ostringstream stream;
+    measure("time + localtime + put_time", [&] {
+        std::time_t now = std::time(nullptr);
+        std::tm localTime;
+        toLocalTime(now, localTime);
+        stream.str("");
+        stream << std::put_time(&localTime, "%Y-%m-%d %H:%M:%S");
+        line = stream.str();
+    });
+    measure("time + localtime + strftime", [&] {
+        std::time_t now = std::time(nullptr);
+        std::tm localTime;
+        toLocalTime(now, localTime);
+        char buffer[32];
+        line.append(buffer, std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &localTime));
+    });
+    LogClock clock;
+    measure("cached second + monotonic offset", [&] { clock.append(line); });
+
+    std::cout << std::defaultfloat << "(" << checksum << " bytes formatted)\n\n";
+
+    // Whole events through each logger, into scratch files removed afterwards: the text log as
+    // writeToLog writes it, flushed per line, and the binary log with the same arguments stored
+    // unformatted, each also buffered so like is compared with like
+    const char* textPath = "book_management.bench.log";
+    const char* binaryPath = "book_management.bench.binlog";
+    auto measureEvents = [&](const char* name, const std::function<size_t()>& bytes,
+                             const std::function<void(size_t)>& emit) {
+        size_t before = bytes();
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; i++) {
+            emit(i);
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start);
+        std::cout << std::left << std::setw(34) << name << std::right << std::setw(8)
+                  << std::fixed << std::setprecision(1)
+                  << static_cast<double>(elapsed.count()) / iterations << " ns per event"
+                  << std::setw(8) << static_cast<double>(bytes() - before) / iterations
+                  << " bytes per event\n";
+    };
+    const std::string message = "User selected to view books.";
+    auto scanEvent = [](size_t i) {
+        return renderLogEvent(LOG_EVENT_SNAPSHOT_SCAN, {i * 64, i, 1.5});
+    };
+
+    std::ofstream textLog(textPath, std::ios::binary | std::ios::trunc);
+    auto textBytes = [&] { return static_cast<size_t>(textLog.tellp()); };
+    measureEvents("text message, flushed", textBytes, [&](size_t) {
+        formatLogLine(line, clock, INFO, message);
+        textLog << line << std::endl;
+    });
+    measureEvents("text scan event, flushed", textBytes, [&](size_t i) {
+        formatLogLine(line, clock, DEBUG, scanEvent(i));
+        textLog << line << std::endl;
+    });
+    measureEvents("text message, buffered", textBytes, [&](size_t) {
+        formatLogLine(line, clock, INFO, message);
+        textLog << line << '\n';
+    });
+    measureEvents("text scan event, buffered", textBytes, [&](size_t i) {
+        formatLogLine(line, clock, DEBUG, scanEvent(i));
+        textLog << line << '\n';
+    });
+    textLog.close();
+
+    {
+        BinaryLogger binary;
+        if (!binary.open(binaryPath)) {
+            std::cerr << "Cannot open " << binaryPath << ".\n";
+            std::remove(textPath);
+            return 1;
+        }
+        auto binaryBytes = [&] { return binary.bytesWritten(); };
+        measureEvents("binary message, flushed", binaryBytes, [&](size_t) {
+            binary.write(INFO, LOG_EVENT_MESSAGE, {message}, clock.nanosecondsSinceEpoch());
+            binary.flush();
+        });
+        measureEvents("binary scan event, flushed", binaryBytes, [&](size_t i) {
+            binary.write(DEBUG, LOG_EVENT_SNAPSHOT_SCAN, {i * 64, i, 1.5},
+                         clock.nanosecondsSinceEpoch());
+            binary.flush();
+        });
+        measureEvents("binary message, buffered", binaryBytes, [&](size_t) {
+            binary.write(INFO, LOG_EVENT_MESSAGE, {message}, clock.nanosecondsSinceEpoch());
+        });
+        measureEvents("binary scan event, buffered", binaryBytes, [&](size_t i) {
+            binary.write(DEBUG, LOG_EVENT_SNAPSHOT_SCAN, {i * 64, i, 1.5},
+                         clock.nanosecondsSinceEpoch());
+        });
+    }
+
+    std::cout << std::defaultfloat;
+    std::remove(textPath);
+    std::remove(binaryPath);
+    return 0;
+}
+
+// Function to time full scans of a database through the default and the io_uring VFS. Each
+// cold scan first asks the kernel to drop the file from its page cache; each warm scan follows
+// it on a fresh connection, so only the kernel's cache is warm.
+int benchmarkVfs(const std::string& path, int rounds) {
+    if (!registerUringVfs(false)) {
+        return 1;
+    }
+    rounds = std::max(rounds, 1);
+
+    // Function to evict the file from the page cache; false if the kernel could not be asked
+    auto evict = [&] {
+#ifdef BOOKS_HAVE_IO_URING
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        fdatasync(fd);
+        bool evicted = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+        close(fd);
+        return evicted;
+#else
+        return false;
+#endif
+    };
+
+    // Function to read every row through the given VFS, returning milliseconds or -1
+    sqlite3_int64 fileBytes = 0;
+    auto scan = [&](const char* vfs) {
+        auto start = std::chrono::steady_clock::now();
+        sqlite3* db = nullptr;
+        sqlite3_stmt* stmt = nullptr;
+        size_t rows = 0;
+        if (sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READONLY, vfs) != SQLITE_OK
+            || sqlite3_prepare_v2(db, "SELECT id, title, author FROM books", -1, &stmt, nullptr)
+                   != SQLITE_OK) {
+            handleSqliteError(db, "VFS benchmark scan");
+            sqlite3_close(db);
+            return -1.0;
+        }
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            rows += sqlite3_column_bytes(stmt, 1) > 0;
+        }
+        sqlite3_finalize(stmt);
+        fileBytes = static_cast<sqlite3_int64>(pragmaValue(db, "page_count"))
+                    * pragmaValue(db, "page_size");
+        if (rc != SQLITE_DONE) {
+            handleSqliteError(db, "VFS benchmark scan");
+            sqlite3_close(db);
+            return -1.0;
+        }
+        sqlite3_close(db);
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+            .count();
+    };
+
+    bool evicted = true;
+    std::cout << std::left << std::setw(8) << "vfs" << std::right << std::setw(12) << "cold ms"
+              << std::setw(12) << "cold MB/s" << std::setw(12) << "warm ms" << std::setw(12)
+              << "warm MB/s" << "\n"
+              << std::fixed << std::setprecision(1);
+    for (const char* vfs : {"unix", URING_VFS_NAME}) {
+        double cold = 0;
+        double warm = 0;
+        for (int round = 0; round < rounds; round++) {
+            evicted = evict() && evicted;
+            double coldScan = scan(vfs);
+            double warmScan = scan(vfs);
+            if (coldScan < 0 || warmScan < 0) {
+                return 1;
+            }
+            cold += coldScan / rounds;
+            warm += warmScan / rounds;
+        }
+        double megabytes = static_cast<double>(fileBytes) / (1024 * 1024);
+        std::cout << std::left << std::setw(8) << vfs << std::right << std::setw(12) << cold
+                  << std::setw(12) << megabytes / (cold / 1000) << std::setw(12) << warm
+                  << std::setw(12) << megabytes / (warm / 1000) << "\n";
+    }
+    std::cout << std::defaultfloat;
+    if (!evicted) {
+        std::cout << "The page cache could not be dropped, so cold scans may have been cached.\n";
+    }
+    return 0;
+}
+
+// Function to describe the command line
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "       " << program << " backup <file>\n"
+              << "       " << program << " check-backup [--writes <n>]\n"
+              << "       " << program << " changes [--from <sequence>] [--follow]\n"
+              << "       " << program << " replicate <follower> [--follow]\n"
+              << "       " << program << " replication-bench [updates]\n"
+              << "       " << program << " view [title|author] [asc|desc] [--limit <k>]\n"
+              << "       " << program << " export <file> [title|author|title-nocase|"
+                 "author-nocase|title-length] [asc|desc] [--memory-mb <n>]\n"
+              << "       " << program << " top-authors [--limit <k>]\n"
+              << "       " << program << " check-author-stats [--rounds <n>] [--seed <s>]\n"
+              << "       " << program << " bulk-delete <selection> [--chunk <n>] [--yes]\n"
+              << "       " << program
+              << " bulk-update <selection> --set-author <name> [--chunk <n>] [--yes]\n"
+              << "       " << program << " storage-stats\n"
+              << "       " << program << " explain\n"
+              << "       " << program << " seed <count>\n"
+              << "       " << program << " startup-timing\n"
+              << "       " << program << " vacuum-migrate\n"
+              << "       " << program << " scan <term> [--threads <n>]\n"
+              << "       " << program << " fuzzy-bench [queries]\n"
+              << "       " << program << " async-bench <file> <requests> [--readers <n>]\n"
+              << "       " << program << " log-bench [iterations]\n"
+              << "       " << program << " vfs-bench [rounds]\n"
+              << "       " << program << " --shards <n> add <title> <author>\n"
+              << "       " << program << " --shards <n> update <id> <title> <author>\n"
+              << "       " << program << " --shards <n> delete <id>\n"
+              << "       " << program << " --shards <n> search <term>\n"
+              << "       " << program << " --shards <n> view [title|author] [asc|desc]\n"
+              << "Bulk selections: --ids <file> (one ID per line), --author <name> or "
+                 "--title-like <pattern>\n"
+              << "Options:\n"
+              << "  --backup-every <seconds> <file>  back up the database in the background\n"
+              << "  --maintain-every <seconds>       release free pages and refresh statistics\n"
+              << "  --binary-log                     log binary records to " << BINARY_LOG_PATH
+              << " (see logdecode)\n"
+              << "  --in-memory                      serve the catalog from a copy in RAM, written"
+              << " back to " << DATABASE_PATH << " on exit\n"
+              << "  --snapshot-every <seconds>       with --in-memory, also write it back"
+              << " periodically\n"
+              << "  --uring-vfs                      read " << DATABASE_PATH
+              << " through io_uring with read-ahead\n"
+              << "  --metrics                        write metrics to " << METRICS_PATH
+              << " on SIGUSR1 and at exit\n"
+              << "  --search-threads <n>             threads for wildcard searches\n"
+              << "  --capture-changes                append every change to " << CHANGE_LOG_PATH
+              << "\n"
+              << "  --publish-changesets             log changesets for followers to "
+              << CHANGESET_LOG_PATH << "\n";
 }
 
 bool checkIfExists(sqlite3* db, int bookId) {
-    const char* checkSQL = "SELECT 1 FROM books WHERE id = ?;";
     sqlite3_stmt* stmt;
 
-    int rc = sqlite3_prepare_v2(db, checkSQL, -1, &stmt, NULL);
+    int rc = sqlite3_prepare_v2(db, CHECK_BOOK_SQL, -1, &stmt, NULL);
     if (rc != SQLITE_OK) {
         handleSqliteError(db, "prepare statement");
         return false;